@@ -0,0 +1,215 @@
+#include "CascadedShadowMap.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+CascadedShadowMap::~CascadedShadowMap() {
+	glDeleteFramebuffers(2, framebuffers);
+	glDeleteTextures(1, &static_texture);
+	glDeleteTextures(1, &texture);
+}
+
+void CascadedShadowMap::invalidate() {
+	for (Cascade &cascade : cascade_states) {
+		cascade.static_valid = false;
+	}
+}
+
+void CascadedShadowMap::allocate() {
+	if (allocated_size == size && allocated_cascades == cascades) return;
+
+	if (texture == 0) glGenTextures(1, &texture);
+	if (static_texture == 0) glGenTextures(1, &static_texture);
+	if (framebuffers[0] == 0) glGenFramebuffers(2, framebuffers);
+
+	for (GLuint tex : {texture, static_texture}) {
+		glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, cascades, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	//the sampled array compares against the reference depth, with linear filtering of the results (2x2 percentage-closer filtering):
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	//depth-only framebuffers:
+	GLint old_framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &old_framebuffer);
+	for (uint32_t f = 0; f < 2; ++f) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[f]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, (f == 0 ? static_texture : texture), 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			throw std::runtime_error("ERROR: shadow map framebuffer is incomplete.");
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, old_framebuffer);
+
+	allocated_size = size;
+	allocated_cascades = cascades;
+	for (Cascade &cascade : cascade_states) {
+		cascade = Cascade();
+	}
+
+	GL_ERRORS();
+}
+
+void CascadedShadowMap::update(Scene const &scene, Scene::Camera const &camera, glm::vec3 const &light_direction_) {
+	assert(camera.transform);
+	cascades = std::max(1U, std::min(cascades, MaxCascades));
+	allocate();
+
+	stats = Stats();
+	frame += 1;
+
+	glm::vec3 direction = glm::normalize(light_direction_);
+	if (direction != light_direction) {
+		light_direction = direction;
+		for (Cascade &cascade : cascade_states) {
+			cascade = Cascade();
+		}
+	}
+
+	//light view space looks along -z (like a camera), so 'z' points toward the light:
+	glm::mat3 light_to_world;
+	{
+		glm::vec3 z = -light_direction;
+		glm::vec3 up = (std::abs(z.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::vec3 x = glm::normalize(glm::cross(up, z));
+		glm::vec3 y = glm::cross(z, x);
+		light_to_world = glm::mat3(x, y, z);
+	}
+	glm::mat3 world_to_light = glm::transpose(light_to_world);
+
+	glm::mat4x3 camera_to_world = camera.transform->make_local_to_world();
+	float tan_y = std::tan(0.5f * camera.fovy);
+	float tan_x = camera.aspect * tan_y;
+
+	//remember how things were, so they can be put back:
+	GLint old_framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &old_framebuffer);
+	GLint old_viewport[4];
+	glGetIntegerv(GL_VIEWPORT, old_viewport);
+
+	glViewport(0, 0, size, size);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(slope_bias, constant_bias);
+
+	float near = camera.near;
+	float far = std::max(max_distance, near * 2.0f);
+	for (uint32_t i = 0; i < cascades; ++i) {
+		Cascade &cascade = cascade_states[i];
+
+		//this cascade's slice of view depth:
+		auto split = [&](uint32_t s) {
+			float t = float(s) / float(cascades);
+			float uniform = near + (far - near) * t;
+			float logarithmic = near * std::pow(far / near, t);
+			return uniform + split_blend * (logarithmic - uniform);
+		};
+		float slice_near = split(i);
+		float slice_far = split(i+1);
+
+		//bounding sphere of the slice, worked out in camera space so its radius doesn't change as the camera turns:
+		// (the center is on the view axis at depth 'c', equidistant from the slice's near and far corners)
+		float near_r2 = slice_near * slice_near * (tan_x * tan_x + tan_y * tan_y);
+		float far_r2 = slice_far * slice_far * (tan_x * tan_x + tan_y * tan_y);
+		float c = 0.5f * (slice_near + slice_far) + 0.5f * (far_r2 - near_r2) / (slice_far - slice_near);
+		c = std::min(c, slice_far); //(for wide views, the far face's circle bounds the slice)
+		float radius = std::sqrt((slice_far - c) * (slice_far - c) + far_r2);
+		glm::vec3 center = world_to_light * (camera_to_world * glm::vec4(0.0f, 0.0f, -c, 1.0f));
+
+		//cascade sizes only change with settings or camera shape:
+		float half_size = radius * (1.0f + margin);
+		if (cascade.near != slice_near || cascade.far != slice_far || std::abs(cascade.half_size - half_size) > 1e-4f * half_size) {
+			cascade = Cascade();
+			cascade.near = slice_near;
+			cascade.far = slice_far;
+		}
+
+		bool due = (cascade.half_size == 0.0f) || ((frame + i) % std::max(1U, update_period[i]) == 0);
+		if (!due) continue;
+
+		//re-center if the slice has left the box:
+		glm::vec3 offset = glm::abs(center - cascade.center);
+		if (cascade.half_size == 0.0f || std::max(offset.x, std::max(offset.y, offset.z)) + radius > cascade.half_size) {
+			cascade.half_size = half_size;
+
+			//snap to whole texels, so static shadow edges stay put as the cascade moves:
+			float texel = 2.0f * half_size / float(size);
+			cascade.center = glm::vec3(
+				std::floor(center.x / texel) * texel,
+				std::floor(center.y / texel) * texel,
+				center.z
+			);
+
+			//orthographic box around the center, reaching caster_distance further toward the light:
+			float z_near = cascade.center.z + half_size + caster_distance;
+			float z_far = cascade.center.z - half_size;
+			glm::mat4 light_to_clip(1.0f);
+			light_to_clip[0][0] = 1.0f / half_size;
+			light_to_clip[1][1] = 1.0f / half_size;
+			light_to_clip[2][2] = -2.0f / (z_near - z_far);
+			light_to_clip[3][0] = -cascade.center.x / half_size;
+			light_to_clip[3][1] = -cascade.center.y / half_size;
+			light_to_clip[3][2] = (z_near + z_far) / (z_near - z_far);
+			cascade.world_to_clip = light_to_clip * glm::mat4(world_to_light);
+
+			cascade.static_valid = false;
+		}
+
+		//redraw static casters into the cache, if needed:
+		if (cache_static && !cascade.static_valid) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, static_texture, 0, i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			stats.casters += scene.draw_depth(cascade.world_to_clip, Scene::StaticDrawables);
+			cascade.static_valid = true;
+			stats.static_redraws += 1;
+		}
+
+		//refresh the layer: cached static casters (or all casters) + dynamic casters:
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[1]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, i);
+		if (cache_static) {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+			glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, static_texture, 0, i);
+			glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[1]);
+			stats.casters += scene.draw_depth(cascade.world_to_clip, Scene::DynamicDrawables);
+		} else {
+			glClear(GL_DEPTH_BUFFER_BIT);
+			stats.casters += scene.draw_depth(cascade.world_to_clip, Scene::AllDrawables);
+		}
+		stats.refreshed += 1;
+
+		//clip space [-1,1]^3 to texture space [0,1]^3:
+		glm::mat4 clip_to_texture(
+			0.5f, 0.0f, 0.0f, 0.0f,
+			0.0f, 0.5f, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.5f, 0.0f,
+			0.5f, 0.5f, 0.5f, 1.0f
+		);
+		world_to_shadow[i] = clip_to_texture * cascade.world_to_clip;
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, old_framebuffer);
+	glViewport(old_viewport[0], old_viewport[1], old_viewport[2], old_viewport[3]);
+
+	GL_ERRORS();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+ * CascadedShadowMap renders depth-from-the-light for a directional light into a texture array,
+ *  one layer per "cascade", each covering a slice of the camera's view depth:
+ *  - slices get longer with distance (a blend of uniform and logarithmic splits)
+ *  - each cascade is an orthographic box fitted around its slice's bounding sphere (so the box
+ *    doesn't change shape as the camera turns) and snapped to whole texels (so shadow edges don't crawl)
+ *  - casters are culled per cascade by their bounds (see Scene::draw_depth)
+ *
+ * To bound the cost per frame:
+ *  - cascades are drawn with some margin, and only re-centered when the camera's slice leaves them
+ *  - static casters (drawables without the 'dynamic' flag) are kept in a cache layer, redrawn
+ *    only when a cascade re-centers; each refresh copies the cache and draws just the dynamic casters on top
+ *  - cascade i is refreshed every update_period[i] frames (so far cascades can update less often)
+ *
+ * Call invalidate() if static casters move.
+ */
+
+#include "GL.hpp"
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+struct CascadedShadowMap {
+	CascadedShadowMap() = default;
+	~CascadedShadowMap();
+
+	CascadedShadowMap(CascadedShadowMap const &) = delete;
+	CascadedShadowMap &operator=(CascadedShadowMap const &) = delete;
+
+	static constexpr uint32_t MaxCascades = 4;
+
+	//settings:
+	uint32_t cascades = 4; //at most MaxCascades
+	uint32_t size = 1024; //texels per side of each cascade
+	float max_distance = 80.0f; //shadows end this far from the camera (along its view direction)
+	float split_blend = 0.75f; //0 => uniform slices, 1 => logarithmic slices
+	float margin = 0.25f; //cascades cover this fraction more than their slice, so small camera motions don't re-center them
+	float caster_distance = 100.0f; //casters up to this far beyond a cascade (toward the light) still cast into it
+	uint32_t update_period[MaxCascades] = {1, 1, 2, 4}; //refresh cascade i every update_period[i] frames
+	bool cache_static = true; //keep static casters in a cache layer (if false, every refresh redraws everything)
+	float slope_bias = 2.0f, constant_bias = 4.0f; //glPolygonOffset while drawing casters (avoids self-shadowing "acne")
+
+	//refresh whichever cascades are due, for 'camera' looking at 'scene', lit by a light shining along 'light_direction' (world space):
+	// (leaves the framebuffer binding and viewport as it found them)
+	void update(Scene const &scene, Scene::Camera const &camera, glm::vec3 const &light_direction);
+
+	//redraw static casters at the next update():
+	void invalidate();
+
+	//results:
+	GLuint texture = 0; //GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, one layer per cascade; compares (GL_LEQUAL), so sample with a sampler2DArrayShadow
+	glm::mat4 world_to_shadow[MaxCascades]; //world to (s, t, -, depth) in [0,1]^3 for each cascade's layer
+
+	struct Stats {
+		uint32_t refreshed = 0; //cascades refreshed by the last update()
+		uint32_t static_redraws = 0; //cascades whose static cache the last update() redrew
+		uint32_t casters = 0; //drawables drawn by the last update()
+	} stats;
+
+	//------ internals ------
+
+	struct Cascade {
+		float near = 0.0f, far = 0.0f; //slice of camera view depth covered
+		glm::vec3 center = glm::vec3(0.0f); //in light view space
+		float half_size = 0.0f; //half the box's width (0 => never drawn)
+		glm::mat4 world_to_clip = glm::mat4(1.0f);
+		bool static_valid = false; //is the static cache layer up to date?
+	};
+	Cascade cascade_states[MaxCascades];
+
+	uint32_t frame = 0; //update() calls so far (for update_period)
+	glm::vec3 light_direction = glm::vec3(0.0f); //direction the caches were drawn for
+
+	GLuint static_texture = 0; //cache of static casters, same layout as 'texture'
+	GLuint framebuffers[2] = {0, 0}; //[0] reads static_texture layers, [1] draws to texture layers
+	uint32_t allocated_size = 0, allocated_cascades = 0;
+	void allocate(); //(re-)create textures to match size and cascades
+};
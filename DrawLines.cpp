@@ -6,57 +6,140 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cstring>
+#include <unordered_map>
+
 //All DrawLines instances share a vertex array object and vertex buffer, initialized at load time:
 
 //n.b. declared static so they don't conflict with similarly named global variables elsewhere:
 static GLuint vertex_buffer = 0;
 static GLuint vertex_buffer_for_color_program = 0;
 
+//vertex_buffer is used as a ring, so that batches append to it instead of re-allocating it:
+// - the ring is split into RingSegments segments; batches never straddle a segment boundary.
+// - a fence is placed when drawing moves out of a segment, and waited on before that segment is written again.
+// - since nothing is overwritten while the GPU might still read it, writes can use unsynchronized maps.
+static constexpr uint32_t RingSegments = 3;
+static uint32_t ring_segment_vertices = 1 << 16; //grows if a single batch is larger than this
+static uint32_t ring_segment = 0; //segment currently being written
+static uint32_t ring_head = 0; //index of next vertex to write
+static GLsync ring_fences[RingSegments] = { };
+
+static void allocate_ring() {
+	for (auto &fence : ring_fences) {
+		if (fence) glDeleteSync(fence);
+		fence = 0;
+	}
+	ring_segment = 0;
+	ring_head = 0;
+
+	//(re-)allocating storage orphans any old contents, so there's no need to wait on draws reading it:
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(RingSegments) * ring_segment_vertices * sizeof(DrawLines::Vertex), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//copy attribs into the ring, returning the index of the first vertex written:
+static GLint append_to_ring(std::vector< DrawLines::Vertex > const &attribs) {
+	uint32_t count = uint32_t(attribs.size());
+
+	if (count > ring_segment_vertices) {
+		while (count > ring_segment_vertices) ring_segment_vertices *= 2;
+		allocate_ring();
+	}
+
+	if (ring_head + count > (ring_segment + 1) * ring_segment_vertices) {
+		//not enough room in this segment; fence it and move to the next one:
+		assert(!ring_fences[ring_segment]);
+		ring_fences[ring_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+		ring_segment = (ring_segment + 1) % RingSegments;
+		ring_head = ring_segment * ring_segment_vertices;
+
+		//make sure the GPU is done with the last batches drawn from the new segment:
+		if (ring_fences[ring_segment]) {
+			while (true) {
+				GLenum result = glClientWaitSync(ring_fences[ring_segment], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+				if (result != GL_TIMEOUT_EXPIRED) break;
+			}
+			glDeleteSync(ring_fences[ring_segment]);
+			ring_fences[ring_segment] = 0;
+		}
+	}
+
+	GLint first = GLint(ring_head);
+	GLintptr offset = GLintptr(ring_head) * sizeof(DrawLines::Vertex);
+	GLsizeiptr size = GLsizeiptr(count) * sizeof(DrawLines::Vertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	void *mapped = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped) {
+		std::memcpy(mapped, attribs.data(), size);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	} else {
+		//mapping failed for some reason; fall back to a plain upload:
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, attribs.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	ring_head += count;
+
+	return first;
+}
+
+//build a vertex array object that reads DrawLines::Vertex arrays from 'buffer' into color_program:
+static GLuint make_vao_for_color_program(GLuint buffer) {
+	//ask OpenGL to fill vao with the name of an unused vertex array object:
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+
+	//set vao as the current vertex array object:
+	glBindVertexArray(vao);
+
+	//set buffer as the source of glVertexAttribPointer() commands:
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	//set up the vertex array object to describe arrays of DrawLines::Vertex:
+	glVertexAttribPointer(
+		color_program->Position_vec4, //attribute
+		3, //size
+		GL_FLOAT, //type
+		GL_FALSE, //normalized
+		sizeof(DrawLines::Vertex), //stride
+		(GLbyte *)0 + offsetof(DrawLines::Vertex, Position) //offset
+	);
+	glEnableVertexAttribArray(color_program->Position_vec4);
+	//[Note that it is okay to bind a vec3 input to a vec4 attribute -- the w component will be filled with 1.0 automatically]
+
+	glVertexAttribPointer(
+		color_program->Color_vec4, //attribute
+		4, //size
+		GL_UNSIGNED_BYTE, //type
+		GL_TRUE, //normalized
+		sizeof(DrawLines::Vertex), //stride
+		(GLbyte *)0 + offsetof(DrawLines::Vertex, Color) //offset
+	);
+	glEnableVertexAttribArray(color_program->Color_vec4);
+
+	//done referring to buffer, so unbind it:
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//done setting up vertex array object, so unbind it:
+	glBindVertexArray(0);
+
+	return vao;
+}
+
 static Load< void > setup_buffers(LoadTagDefault, [](){
 	//you may recognize this init code from DrawSprites.cpp:
 
 	{ //set up vertex buffer:
 		glGenBuffers(1, &vertex_buffer);
-		//for now, buffer will be un-filled.
+		allocate_ring();
 	}
 
 	{ //vertex array mapping buffer for color_program:
-		//ask OpenGL to fill vertex_buffer_for_color_program with the name of an unused vertex array object:
-		glGenVertexArrays(1, &vertex_buffer_for_color_program);
-
-		//set vertex_buffer_for_color_program as the current vertex array object:
-		glBindVertexArray(vertex_buffer_for_color_program);
-
-		//set vertex_buffer as the source of glVertexAttribPointer() commands:
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-		//set up the vertex array object to describe arrays of PongMode::Vertex:
-		glVertexAttribPointer(
-			color_program->Position_vec4, //attribute
-			3, //size
-			GL_FLOAT, //type
-			GL_FALSE, //normalized
-			sizeof(DrawLines::Vertex), //stride
-			(GLbyte *)0 + offsetof(DrawLines::Vertex, Position) //offset
-		);
-		glEnableVertexAttribArray(color_program->Position_vec4);
-		//[Note that it is okay to bind a vec3 input to a vec4 attribute -- the w component will be filled with 1.0 automatically]
-
-		glVertexAttribPointer(
-			color_program->Color_vec4, //attribute
-			4, //size
-			GL_UNSIGNED_BYTE, //type
-			GL_TRUE, //normalized
-			sizeof(DrawLines::Vertex), //stride
-			(GLbyte *)0 + offsetof(DrawLines::Vertex, Color) //offset
-		);
-		glEnableVertexAttribArray(color_program->Color_vec4);
-
-		//done referring to vertex_buffer, so unbind it:
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		//done setting up vertex array object, so unbind it:
-		glBindVertexArray(0);
+		vertex_buffer_for_color_program = make_vao_for_color_program(vertex_buffer);
 	}
 
 	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
@@ -90,46 +173,30 @@ void DrawLines::draw_box(glm::mat4x3 const &mat, glm::u8vec4 const &color) {
 	draw(mat * glm::vec4( 1.0f, 1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f), color);
 }
 
-void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
-
-	glm::vec3 anchor = anchor_in;
+//draw_text() reuses layouts of strings it has drawn recently, so text that doesn't change
+// from frame to frame only pays for a hash lookup and a transform of the cached points:
+struct TextLayout {
+	std::vector< glm::vec2 > lines; //line segment endpoints, in character-box units
+	float advance = 0.0f;
+};
+static std::unordered_map< std::string, TextLayout > text_layouts;
+static constexpr size_t MaxTextLayouts = 1024; //cache is flushed if it grows past this many strings
+
+void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
+
+	auto f = text_layouts.find(text);
+	if (f == text_layouts.end()) {
+		if (text_layouts.size() >= MaxTextLayouts) text_layouts.clear();
+		f = text_layouts.emplace(text, TextLayout()).first;
+		f->second.advance = PathFont::font.layout(text, &f->second.lines);
+	}
+	TextLayout const &layout = f->second;
 
-	uint32_t start = 0;
-	while (start < text.size()) {
-		uint32_t end = start;
-		uint32_t glyph = -1U;
-		while (end < text.size()) {
-			end += 1;
-			auto f = PathFont::font.glyph_map.find(text.substr(start, end-start));
-			if (f == PathFont::font.glyph_map.end()) {
-				end -= 1;
-				break;
-			}
-			glyph = f->second;
-		}
-		if (glyph == -1U) {
-			assert(start == end);
-			end += 1;
-			//missing! draw a tofu:
-			for (const auto &pt : {
-				glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
-				glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
-				glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
-				glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
-			}) {
-				attribs.emplace_back(anchor + pt.x * x + pt.y * y, color);
-			}
-			anchor += x * 0.6f;
-		} else {
-			for (uint32_t c = PathFont::font.glyph_coord_starts[glyph]; c + 1 < PathFont::font.glyph_coord_starts[glyph+1]; c += 2) {
-				attribs.emplace_back(anchor + x * PathFont::font.coords[c] + y * PathFont::font.coords[c+1], color);
-			}
-			anchor += x * PathFont::font.glyph_widths[glyph];
-		}
-		start = end;
+	for (auto const &pt : layout.lines) {
+		attribs.emplace_back(anchor + pt.x * x + pt.y * y, color);
 	}
 
-	if (anchor_out) *anchor_out = anchor;
+	if (anchor_out) *anchor_out = anchor + layout.advance * x;
 }
 
 DrawLines::~DrawLines() {
@@ -137,10 +204,8 @@ DrawLines::~DrawLines() {
 
 	//based on DrawSprites.cpp :
 
-	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
-	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//append vertices to the vertex_buffer ring:
+	GLint first = append_to_ring(attribs);
 
 	//set color_program as current program:
 	glUseProgram(color_program->program);
@@ -152,7 +217,7 @@ DrawLines::~DrawLines() {
 	glBindVertexArray(vertex_buffer_for_color_program);
 
 	//run the OpenGL pipeline:
-	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
+	glDrawArrays(GL_LINES, first, GLsizei(attribs.size()));
 
 	//reset vertex array to none:
 	glBindVertexArray(0);
@@ -162,3 +227,59 @@ DrawLines::~DrawLines() {
 }
 
 
+
+//-------------------------
+
+TextLines::TextLines() {
+	glGenBuffers(1, &buffer);
+	vao = make_vao_for_color_program(buffer);
+}
+
+TextLines::~TextLines() {
+	glDeleteVertexArrays(1, &vao);
+	vao = 0;
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void TextLines::set(std::string const &text_, glm::vec3 const &anchor_, glm::vec3 const &x_, glm::vec3 const &y_, glm::u8vec4 const &color_) {
+	//nothing to do if nothing changed:
+	if (text_ == text && anchor_ == anchor && x_ == x && y_ == y && color_ == color) return;
+
+	text = text_;
+	anchor = anchor_;
+	x = x_;
+	y = y_;
+	color = color_;
+
+	//re-generate vertices:
+	static std::vector< glm::vec2 > lines; //n.b. static so allocation is re-used between calls
+	lines.clear();
+	PathFont::font.layout(text, &lines);
+
+	std::vector< DrawLines::Vertex > attribs;
+	attribs.reserve(lines.size());
+	for (auto const &pt : lines) {
+		attribs.emplace_back(anchor + pt.x * x + pt.y * y, color);
+	}
+
+	//upload to this text's own buffer:
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	count = GLsizei(attribs.size());
+}
+
+void TextLines::draw(glm::mat4 const &world_to_clip) const {
+	if (count == 0) return;
+
+	glUseProgram(color_program->program);
+	glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+	glBindVertexArray(vao);
+
+	glDrawArrays(GL_LINES, 0, count);
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -9,6 +9,8 @@
  */
 
 
+#include "GL.hpp"
+
 #include <glm/glm.hpp>
 
 #include <string>
@@ -46,3 +48,36 @@ struct DrawLines {
 	std::vector< Vertex > attribs;
 
 };
+
+//Retained-mode counterpart to DrawLines::draw_text -- keeps its line vertices in its own
+// vertex buffer, and only re-generates them when the text, placement, or color change:
+struct TextLines {
+	TextLines();
+	~TextLines();
+
+	//owns OpenGL objects, so copying is not allowed:
+	TextLines(TextLines const &) = delete;
+	TextLines &operator=(TextLines const &) = delete;
+
+	//set what to draw (parameters as per DrawLines::draw_text); cheap if nothing changed:
+	void set(std::string const &text,
+		glm::vec3 const &anchor,
+		glm::vec3 const &x = glm::vec3(1.0f, 0.0f, 0.0f),
+		glm::vec3 const &y = glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::u8vec4 const &color = glm::u8vec4(0xff));
+
+	//draw the text with the given transform:
+	void draw(glm::mat4 const &world_to_clip) const;
+
+	//parameters vertices were last generated from:
+	std::string text;
+	glm::vec3 anchor = glm::vec3(0.0f);
+	glm::vec3 x = glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 y = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::u8vec4 color = glm::u8vec4(0xff);
+
+	//vertices (DrawLines::Vertex format) for drawing as GL_LINES:
+	GLuint buffer = 0;
+	GLuint vao = 0;
+	GLsizei count = 0;
+};
@@ -0,0 +1,222 @@
+#include "FrameBenchmark.hpp"
+
+#include "Mode.hpp"
+#include "Scene.hpp"
+#include "TextureLoader.hpp"
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+void FrameBenchmark::parse_arguments(int &argc, char **argv) {
+	int kept = 1;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) throw std::runtime_error("Expecting a value after '" + arg + "'.");
+			i += 1;
+			return argv[i];
+		};
+		if (arg == "--benchmark") {
+			std::string count = value();
+			frames = uint32_t(std::stoul(count));
+			if (frames == 0) throw std::runtime_error("Expecting a positive frame count after '--benchmark', got '" + count + "'.");
+		} else if (arg == "--benchmark-size") {
+			std::string wh = value();
+			unsigned int w = 0, h = 0;
+			char x = '\0';
+			if (std::sscanf(wh.c_str(), "%u%c%u", &w, &x, &h) != 3 || x != 'x' || w == 0 || h == 0) {
+				throw std::runtime_error("Expecting a size like '1280x720' after '--benchmark-size', got '" + wh + "'.");
+			}
+			size = glm::uvec2(w, h);
+		} else if (arg == "--benchmark-csv") {
+			csv = value();
+		} else if (arg == "--golden") {
+			golden = value();
+		} else if (arg == "--depth-prepass") {
+			depth_prepass = true;
+		} else if (arg == "--overdraw") {
+			measure_overdraw = true;
+		} else {
+			argv[kept++] = argv[i];
+		}
+	}
+	argc = kept;
+	argv[argc] = nullptr;
+}
+
+void FrameBenchmark::configure(Mode &mode) const {
+	Scene *scene = mode.drawn_scene();
+	if (!scene) {
+		if (depth_prepass || measure_overdraw) std::cerr << "NOTE: mode draws no Scene; ignoring '--depth-prepass' / '--overdraw'." << std::endl;
+		return;
+	}
+	scene->depth_prepass = depth_prepass;
+	scene->measure_overdraw = measure_overdraw;
+}
+
+//(mean, median, 95th percentile, max) of some timings:
+static std::array< float, 4 > summarize(std::vector< float > times) {
+	if (times.empty()) return {0.0f, 0.0f, 0.0f, 0.0f};
+	std::sort(times.begin(), times.end());
+	double total = 0.0;
+	for (float t : times) total += t;
+	return {
+		float(total / times.size()),
+		times[times.size() / 2],
+		times[std::min(times.size() - 1, times.size() * 95 / 100)],
+		times.back()
+	};
+}
+
+bool FrameBenchmark::run() {
+	assert(Mode::current);
+	configure(*Mode::current);
+
+	//offscreen framebuffer:
+	GLuint color = 0, depth = 0, framebuffer = 0;
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("ERROR: benchmark framebuffer is incomplete.");
+	}
+	glViewport(0, 0, size.x, size.y);
+
+	//timer queries are read back a few frames late, so waiting on them doesn't drain the GPU's queue each frame:
+	std::array< GLuint, 4 > queries;
+	glGenQueries(GLsizei(queries.size()), queries.data());
+
+	cpu_ms.assign(frames, 0.0f);
+	gpu_ms.assign(frames, 0.0f);
+	prepare_ms.assign(frames, 0.0f);
+	submit_ms.assign(frames, 0.0f);
+	shaded_samples.assign(frames, 0);
+	overdraw.assign(frames, 0.0f);
+	auto read_gpu_time = [&](uint32_t f) {
+		if (f < warmup) return;
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(queries[f % queries.size()], GL_QUERY_RESULT, &ns);
+		gpu_ms[f - warmup] = float(double(ns) * 1e-6);
+	};
+
+	bool finished = true;
+	uint32_t total = warmup + frames;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t f = 0; f < total; ++f) {
+		if (f >= queries.size()) read_gpu_time(f - uint32_t(queries.size()));
+
+		auto before = std::chrono::high_resolution_clock::now();
+
+		std::shared_ptr< Mode > mode = Mode::current;
+		float t = (f < warmup || frames == 1 ? 0.0f : float(f - warmup) / float(frames - 1));
+		mode->set_benchmark_view(t);
+		mode->update(step);
+		if (!Mode::current) {
+			std::cerr << "Mode quit after " << f << " benchmark frames." << std::endl;
+			finished = false;
+			break;
+		}
+		mode = Mode::current;
+		mode->snapshot();
+
+		//as main.cpp does each frame:
+		TextureLoader::shared().update();
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[f % queries.size()]);
+		mode->draw(size);
+		glEndQuery(GL_TIME_ELAPSED);
+
+		auto after = std::chrono::high_resolution_clock::now();
+		if (f >= warmup) {
+			cpu_ms[f - warmup] = std::chrono::duration< float, std::milli >(after - before).count();
+			if (Scene const *scene = mode->drawn_scene()) {
+				prepare_ms[f - warmup] = scene->draw_stats.prepare_ms;
+				submit_ms[f - warmup] = scene->draw_stats.submit_ms;
+				shaded_samples[f - warmup] = scene->draw_stats.shaded_samples;
+				overdraw[f - warmup] = scene->draw_stats.overdraw;
+			}
+		}
+	}
+	if (finished) {
+		for (uint32_t f = (total > queries.size() ? total - uint32_t(queries.size()) : 0); f < total; ++f) {
+			read_gpu_time(f);
+		}
+	}
+	glFinish();
+	auto end = std::chrono::high_resolution_clock::now();
+
+	if (finished) {
+		float wall_ms = std::chrono::duration< float, std::milli >(end - start).count();
+		auto cpu = summarize(cpu_ms);
+		auto gpu = summarize(gpu_ms);
+		std::cout << "Benchmark: " << frames << " frames (after " << warmup << " warmup) at " << size.x << "x" << size.y << ", "
+		          << wall_ms / float(warmup + frames) << " ms/frame overall." << std::endl;
+		std::cout << "  cpu ms: mean " << cpu[0] << ", median " << cpu[1] << ", p95 " << cpu[2] << ", max " << cpu[3] << std::endl;
+		std::cout << "  gpu ms: mean " << gpu[0] << ", median " << gpu[1] << ", p95 " << gpu[2] << ", max " << gpu[3] << std::endl;
+		if (Mode::current->drawn_scene()) {
+			auto prepare = summarize(prepare_ms);
+			auto submit = summarize(submit_ms);
+			std::cout << "  scene prepare ms (cpu): mean " << prepare[0] << ", median " << prepare[1] << ", p95 " << prepare[2] << ", max " << prepare[3] << std::endl;
+			std::cout << "  scene submit ms (cpu): mean " << submit[0] << ", median " << submit[1] << ", p95 " << submit[2] << ", max " << submit[3] << std::endl;
+			if (measure_overdraw) {
+				//(query results lag a few frames, and frames with all queries in flight repeat the previous result)
+				auto ratio = summarize(overdraw);
+				double samples = 0.0;
+				for (uint32_t s : shaded_samples) samples += s;
+				std::cout << "  overdraw (shaded samples per pixel" << (depth_prepass ? ", with depth pre-pass" : "") << "): mean " << ratio[0] << ", median " << ratio[1] << ", p95 " << ratio[2] << ", max " << ratio[3]
+				          << "; mean shaded samples " << (frames ? samples / frames : 0.0) << std::endl;
+			}
+		}
+
+		if (!csv.empty()) {
+			std::ofstream out(csv);
+			if (!out) throw std::runtime_error("Failed to open '" + csv + "' for writing.");
+			out << "frame,cpu_ms,gpu_ms,prepare_ms,submit_ms,shaded_samples,overdraw\n";
+			for (uint32_t f = 0; f < frames; ++f) {
+				out << f << ',' << cpu_ms[f] << ',' << gpu_ms[f] << ',' << prepare_ms[f] << ',' << submit_ms[f] << ',' << shaded_samples[f] << ',' << overdraw[f] << '\n';
+			}
+			std::cout << "  wrote per-frame timings to '" << csv << "'." << std::endl;
+		}
+
+		if (!golden.empty()) {
+			std::vector< glm::u8vec4 > data(size.x * size.y);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+			for (auto &px : data) {
+				px.a = 0xff;
+			}
+			save_png(golden, size, data.data(), LowerLeftOrigin);
+			std::cout << "  saved last frame to '" << golden << "'." << std::endl;
+		}
+	}
+
+	glDeleteQueries(GLsizei(queries.size()), queries.data());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &depth);
+	glDeleteRenderbuffers(1, &color);
+
+	GL_ERRORS();
+
+	return finished;
+}
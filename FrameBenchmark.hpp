@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * FrameBenchmark runs the current Mode headless, for automated performance and regression checks:
+ *  - frames are drawn into an offscreen framebuffer (so no visible window or swap chain is needed)
+ *  - update() gets a fixed time step, and the view follows the mode's set_benchmark_view() path
+ *  - each frame's CPU time (update + draw) and GPU time (GL_TIME_ELAPSED query around draw) is recorded,
+ *    along with the mode's Scene::draw_stats stage timings and overdraw (see Mode::drawn_scene())
+ *  - a summary is printed at the end; per-frame timings and the last frame (as a "golden image" PNG) can be saved
+ *
+ * Command line (recognized and removed by parse_arguments()):
+ *   --benchmark <frames>        run this many timed frames, then exit
+ *   --benchmark-size <W>x<H>    framebuffer size (default 1280x720)
+ *   --benchmark-csv <file>      write "frame,cpu_ms,gpu_ms,prepare_ms,submit_ms,shaded_samples,overdraw" lines
+ *   --golden <file.png>         save the last frame
+ *
+ * Rendering switches (also recognized by parse_arguments(), and applied to interactive runs by configure()):
+ *   --depth-prepass             set Scene::depth_prepass
+ *   --overdraw                  set Scene::measure_overdraw (and report overdraw)
+ *
+ * The mains create a hidden window with swap interval 0 when benchmarking.
+ * Without a GPU (e.g., on CI), Mesa's llvmpipe works: run under xvfb-run (or with
+ *  SDL_VIDEODRIVER=offscreen on SDL builds with EGL) and LIBGL_ALWAYS_SOFTWARE=1.
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+struct Mode;
+
+#include <string>
+#include <vector>
+
+struct FrameBenchmark {
+	//settings:
+	uint32_t frames = 0; //timed frames; 0 => not benchmarking
+	uint32_t warmup = 10; //untimed frames drawn first (e.g., while textures stream in)
+	glm::uvec2 size = glm::uvec2(1280, 720);
+	float step = 1.0f / 60.0f; //seconds passed to each update()
+	std::string csv; //if non-empty, per-frame timings are written here
+	std::string golden; //if non-empty, the last frame is saved here (as PNG)
+	bool depth_prepass = false; //draw with Scene::depth_prepass
+	bool measure_overdraw = false; //draw with Scene::measure_overdraw
+
+	bool enabled() const { return frames > 0; }
+
+	//pick out (and remove from argv) the arguments listed above; throws on malformed values:
+	void parse_arguments(int &argc, char **argv);
+
+	//apply the rendering switches to mode's drawn_scene() (if it has one):
+	void configure(Mode &mode) const;
+
+	//draw warmup + frames frames of Mode::current (which should already be set), then report;
+	// returns false if the mode quit before the end:
+	bool run();
+
+	//------ results ------
+	std::vector< float > cpu_ms; //per timed frame
+	std::vector< float > gpu_ms; //per timed frame
+	std::vector< float > prepare_ms; //per timed frame; Scene::draw_stats.prepare_ms of drawn_scene() (0 if none)
+	std::vector< float > submit_ms; //per timed frame; Scene::draw_stats.submit_ms of drawn_scene() (0 if none)
+	std::vector< uint32_t > shaded_samples; //per timed frame; Scene::draw_stats.shaded_samples (0 unless measure_overdraw)
+	std::vector< float > overdraw; //per timed frame; Scene::draw_stats.overdraw (0 unless measure_overdraw)
+};
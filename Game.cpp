@@ -5,25 +5,41 @@
 
 namespace Game {
 
+std::function<Scene::Transform *()> Game::make_cloner(Scene &scene, Scene::Transform *model) {
+    if (model == nullptr) return nullptr;
+    std::vector<Scene::Drawable> drawables;
+    for (auto const &drawable : scene.drawables) {
+        if (drawable.transform == model) drawables.emplace_back(drawable);
+    }
+    return [&scene, model, drawables]() {
+        scene.transforms.emplace_back();
+        Scene::Transform *clone = &scene.transforms.back();
+        clone->name = model->name;
+        clone->parent = model->parent;
+        clone->rotation = model->rotation;
+        clone->scale = model->scale;
+        clone->position = DEFAULT_MODEL_POSITION;
+        for (auto const &drawable : drawables) {
+            scene.drawables.emplace_back(drawable);
+            scene.drawables.back().transform = clone;
+        }
+        return clone;
+    };
+}
+
 Scene::Transform *Game::get_free_rocket() {
-    assert(!rocket_models.empty());
-    Scene::Transform *res = rocket_models[rocket_models.size() - 1];
-    rocket_models.pop_back();
-    return res;
+    return rocket_models.acquire();
 }
 Scene::Transform *Game::get_free_target() {
-    assert(!target_models.empty());
-    Scene::Transform *res = target_models[target_models.size() - 1];
-    target_models.pop_back();
-    return res;
+    return target_models.acquire();
 }
 void Game::release_target(Scene::Transform *target) {
     target->position = DEFAULT_MODEL_POSITION;
-    target_models.emplace_back(target);
+    target_models.release(target);
 }
 void Game::release_rocket(Scene::Transform *rocket) {
     rocket->position = DEFAULT_MODEL_POSITION;
-    rocket_models.emplace_back(rocket); 
+    rocket_models.release(rocket); 
 }
 
 
@@ -42,7 +58,9 @@ void Game::shoot(const glm::vec3& pos, float pitch, float xyroll) {
     glm::vec3 xyactual = xynorm * xyfrac;
     glm::vec3 velo(xyactual.x, xyactual.y, zfrac);
     velo = velo * ROCKET_SPEED;
-    auto rocket = std::make_shared<Rocket>(ROCKET_RADIUS, pos, velo, get_free_rocket()); 
+    Scene::Transform *model = get_free_rocket();
+    if (model == nullptr) return; // pool is at its limit
+    auto rocket = std::make_shared<Rocket>(ROCKET_RADIUS, pos, velo, model); 
     rockets.emplace_back(rocket); 
     player_shoot_sample = Sound::play(player_shoot_audio);
 }
@@ -117,7 +135,9 @@ void Game::launch_new_target() {
 
     glm::vec3 velo(x, y, z);
     velo = glm::normalize(velo) * TARGET_SPEED;
-    auto target = std::make_shared<Target>(TARGET_RADIUS, TARGET_LAUNCH_POSITION, velo, get_free_target()); 
+    Scene::Transform *model = get_free_target();
+    if (model == nullptr) return; // pool is at its limit
+    auto target = std::make_shared<Target>(TARGET_RADIUS, TARGET_LAUNCH_POSITION, velo, model); 
     targets.emplace_back(target);  
 
     target_shoot_sample = Sound::play(target_shoot_audio); 
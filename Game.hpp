@@ -3,6 +3,7 @@
 
 #include "Scene.hpp"
 #include "Sound.hpp"
+#include "Pool.hpp"
 #include "data_path.hpp"
 
 #include <glm/glm.hpp>
@@ -10,6 +11,7 @@
 #include <list>
 #include <vector>
 #include <array>
+#include <algorithm>
 #include <unordered_map>
 #include <memory>
 #include <cassert>
@@ -42,6 +44,9 @@ constexpr const char * HIT_AUDIO = "sounds/hit.opus";
 constexpr float GRAVITY = 9.8f;
 
 constexpr float TARGET_CLIP_DIST = 500.f;
+// pools grow (by cloning a model) up to these sizes, then further shots/launches are dropped:
+constexpr uint32_t MAX_ROCKETS = 128;
+constexpr uint32_t MAX_TARGETS = 128;
 
 struct Projectile {
     Projectile (float r, const glm::vec3& pos, const glm::vec3& velo, Scene::Transform *m) {
@@ -95,13 +100,15 @@ struct Rocket : Projectile {
 };
 
 struct Game {
-    Game(const Scene& scene) : 
+    Game(Scene& scene) : 
              bonus_audio(data_path(BONUS_MOVED_AUDIO)),
              bonus_timer_audio(data_path(BONUS_5SEC_AUDIO)),
              entered_bonus_audio(data_path(ENTERED_BONUS_AUDIO)),
              player_shoot_audio(data_path(PLAYER_SHOOT_AUDIO)),
              target_shoot_audio(data_path(TARGET_SHOOT_AUDIO)),
-             hit_audio(data_path(HIT_AUDIO)) {
+             hit_audio(data_path(HIT_AUDIO)),
+             rocket_models(nullptr, Pool<Scene::Transform *>::Grow, MAX_ROCKETS),
+             target_models(nullptr, Pool<Scene::Transform *>::Grow, MAX_TARGETS) {
         
         // Hardcoded from model being used as platform
         this->xmin = -10;
@@ -116,23 +123,38 @@ struct Game {
 
         dis = std::uniform_real_distribution(0.f, 1.f);
 
-        for (auto &transform : scene.transforms) {
-            Scene::Transform *model = const_cast<Scene::Transform *>(&transform);
-            if (transform.name.substr(0, 7) == "Target.") {
-                model->position = DEFAULT_MODEL_POSITION;
-                target_models.emplace_back(model); 
-            }
-            else if (transform.name.substr(0, 7) == "Rocket.") {
-                model->position = DEFAULT_MODEL_POSITION;
-                rocket_models.emplace_back(model);
-            } 
-            else if (transform.name.substr(0, 7) == "Shooter") {
-                model->position = TARGET_LAUNCH_POSITION;
+        Scene::Transform *rocket_template = nullptr;
+        Scene::Transform *target_template = nullptr;
+        auto [targets_begin, targets_end] = scene.find_prefix("Target.");
+        for (auto it = targets_begin; it != targets_end; ++it) {
+            it->transform->position = DEFAULT_MODEL_POSITION;
+            target_models.add(it->transform);
+            if (!target_template) target_template = it->transform;
+        }
+        auto [rockets_begin, rockets_end] = scene.find_prefix("Rocket.");
+        for (auto it = rockets_begin; it != rockets_end; ++it) {
+            it->transform->position = DEFAULT_MODEL_POSITION;
+            rocket_models.add(it->transform);
+            if (!rocket_template) rocket_template = it->transform;
+        }
+        auto [shooters_begin, shooters_end] = scene.find_prefix("Shooter");
+        for (auto it = shooters_begin; it != shooters_end; ++it) {
+            it->transform->position = TARGET_LAUNCH_POSITION;
+        }
+        bonus = scene.find("Bonus");
+        assert(bonus && "scene should contain a 'Bonus' transform");
+        // targets, rockets, and the bonus move during play, so shadow maps shouldn't cache them:
+        // (clones made by make_cloner copy this flag along with the rest of the drawable)
+        for (auto &drawable : scene.drawables) {
+            Scene::Transform *t = drawable.transform;
+            if (t == bonus
+             || std::find(target_models.free_list.begin(), target_models.free_list.end(), t) != target_models.free_list.end()
+             || std::find(rocket_models.free_list.begin(), rocket_models.free_list.end(), t) != rocket_models.free_list.end()) {
+                drawable.dynamic = true;
             }
-            else if (transform.name.substr(0, 7) == "Bonus") {
-                bonus = model;
-            } 
-        }  
+        }
+        rocket_models.make = make_cloner(scene, rocket_template);
+        target_models.make = make_cloner(scene, target_template);
         move_bonus_position();
          
         rockets.clear();
@@ -159,6 +181,9 @@ struct Game {
     ~Game() = default;
 
     private:
+        // returns a function that clones 'model' (and the drawables attached to it) into 'scene':
+        static std::function<Scene::Transform *()> make_cloner(Scene &scene, Scene::Transform *model);
+
         Scene::Transform *get_free_rocket();
         Scene::Transform *get_free_target();
         void release_rocket(Scene::Transform *rocket);
@@ -183,8 +208,8 @@ struct Game {
         std::vector<std::shared_ptr<Target>> targets;
         std::vector<std::shared_ptr<Rocket>> rockets;
         std::unordered_map<char, Sound::Sample> path_audio;
-        std::vector<Scene::Transform *> rocket_models;
-        std::vector<Scene::Transform *> target_models;
+        Pool<Scene::Transform *> rocket_models;
+        Pool<Scene::Transform *> target_models;
 };
 
 }
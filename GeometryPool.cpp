@@ -0,0 +1,201 @@
+#include "GeometryPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+GeometryPool &GeometryPool::shared(Format const &format) {
+	//n.b. pools are never deleted (like Load<>'d resources), since the GL context may be gone by the time statics are destroyed:
+	static std::vector< GeometryPool * > pools;
+	for (GeometryPool *pool : pools) {
+		if (pool->format == format) return *pool;
+	}
+	pools.emplace_back(new GeometryPool(format));
+	return *pools.back();
+}
+
+GeometryPool::GeometryPool(Format const &format_) : format(format_) {
+	assert(format.stride > 0);
+}
+
+GeometryPool::~GeometryPool() {
+	for (Arena &arena : arenas) {
+		for (auto const &[layout, vao] : arena.vaos) {
+			glDeleteVertexArrays(1, &vao);
+		}
+		glDeleteBuffers(1, &arena.buffer);
+	}
+	arenas.clear();
+}
+
+GeometryPool::Range GeometryPool::allocate(GLuint count, void const *data) {
+	Range range;
+
+	//(empty allocations still get an arena, so there is a buffer to make vaos for)
+	if (count == 0 && !arenas.empty()) {
+		range.arena = 0;
+		return range;
+	}
+
+	//first fit in an existing arena:
+	for (uint32_t a = 0; a < arenas.size() && range.arena == -1U; ++a) {
+		auto &free = arenas[a].free;
+		for (auto f = free.begin(); f != free.end(); ++f) {
+			if (f->second < count) continue;
+			range.arena = a;
+			range.start = f->first;
+			range.count = count;
+			if (f->second > count) free.emplace(f->first + count, f->second - count);
+			free.erase(f);
+			break;
+		}
+	}
+
+	//...or in a new arena:
+	if (range.arena == -1U) {
+		Arena arena;
+		arena.capacity = std::max(count, ArenaVertices);
+		glGenBuffers(1, &arena.buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, arena.buffer);
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(arena.capacity) * format.stride, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		if (arena.capacity > count) arena.free.emplace(count, arena.capacity - count);
+
+		range.arena = uint32_t(arenas.size());
+		range.start = 0;
+		range.count = count;
+		arenas.emplace_back(std::move(arena));
+	}
+
+	if (count > 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, arenas[range.arena].buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(range.start) * format.stride, GLsizeiptr(count) * format.stride, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	return range;
+}
+
+void GeometryPool::free(Range const &range) {
+	if (range.arena == -1U || range.count == 0) return;
+	assert(range.arena < arenas.size());
+	auto &free = arenas[range.arena].free;
+
+	auto f = free.emplace(range.start, range.count).first;
+	assert(f->second == range.count && "range should not already be free");
+
+	//merge with following range:
+	auto next = std::next(f);
+	if (next != free.end() && f->first + f->second == next->first) {
+		f->second += next->second;
+		free.erase(next);
+	}
+	//merge with preceding range:
+	if (f != free.begin()) {
+		auto prev = std::prev(f);
+		if (prev->first + prev->second == f->first) {
+			prev->second += f->second;
+			free.erase(f);
+		}
+	}
+}
+
+//Attribute locations of programs seen by vao_for_program (these don't depend on the pool, so are shared):
+struct ProgramAttribs {
+	GLuint program = 0;
+	glm::ivec4 locations = glm::ivec4(-1); //of Position, Normal, Color, TexCoord
+	std::string unknown; //name of an active attribute not in the list above (if any)
+};
+static std::vector< ProgramAttribs > &program_attribs() {
+	static std::vector< ProgramAttribs > cache;
+	return cache;
+}
+
+void GeometryPool::forget_program(GLuint program) {
+	auto &cache = program_attribs();
+	cache.erase(std::remove_if(cache.begin(), cache.end(), [&](ProgramAttribs const &pa) {
+		return pa.program == program;
+	}), cache.end());
+}
+
+GLuint GeometryPool::vao_for_program(uint32_t arena_index, GLuint program) {
+	assert(arena_index < arenas.size());
+	Arena &arena = arenas[arena_index];
+
+	//look up (or query once) which locations the program wants attributes at:
+	auto &cache = program_attribs();
+	auto found = std::find_if(cache.begin(), cache.end(), [&](ProgramAttribs const &pa) {
+		return pa.program == program;
+	});
+	if (found == cache.end()) {
+		ProgramAttribs pa;
+		pa.program = program;
+		pa.locations = glm::ivec4(
+			glGetAttribLocation(program, "Position"),
+			glGetAttribLocation(program, "Normal"),
+			glGetAttribLocation(program, "Color"),
+			glGetAttribLocation(program, "TexCoord")
+		);
+
+		//remember any active attribute this code doesn't know how to supply:
+		GLint active = 0;
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &active);
+		assert(active >= 0 && "Doesn't makes sense to have negative active attributes.");
+		GLint max_length = 0;
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+		std::vector< GLchar > name(std::max(max_length, 1), '\0');
+		for (GLuint i = 0; i < GLuint(active); ++i) {
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveAttrib(program, i, GLsizei(name.size()), &length, &size, &type, name.data());
+			GLint location = glGetAttribLocation(program, name.data());
+			if (location == -1) continue; //built-in (e.g., gl_VertexID)
+			if (location != pa.locations[0] && location != pa.locations[1] && location != pa.locations[2] && location != pa.locations[3]) {
+				pa.unknown = std::string(name.data(), length);
+				break;
+			}
+		}
+
+		cache.emplace_back(pa);
+		found = cache.end() - 1;
+	}
+	ProgramAttribs const &pa = *found;
+
+	//Check that all active attributes can be bound from this format:
+	if (!pa.unknown.empty()) {
+		throw std::runtime_error("ERROR: active attribute '" + pa.unknown + "' in program is not bound.");
+	}
+	Attrib const *attribs[4] = { &format.Position, &format.Normal, &format.Color, &format.TexCoord };
+	char const *names[4] = { "Position", "Normal", "Color", "TexCoord" };
+	glm::ivec4 layout = pa.locations;
+	for (uint32_t a = 0; a < 4; ++a) {
+		if (layout[a] != -1 && attribs[a]->size == 0) {
+			throw std::runtime_error("ERROR: active attribute '" + std::string(names[a]) + "' in program is not bound.");
+		}
+	}
+
+	//re-use a vao that binds the same locations, if there is one:
+	for (auto const &[vao_layout, vao] : arena.vaos) {
+		if (vao_layout == layout) return vao;
+	}
+
+	//otherwise, create a new vertex array object:
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, arena.buffer);
+	for (uint32_t a = 0; a < 4; ++a) {
+		if (layout[a] == -1) continue; //can't bind missing attribs
+		Attrib const &attrib = *attribs[a];
+		glVertexAttribPointer(layout[a], attrib.size, attrib.type, attrib.normalized, attrib.stride, (GLbyte *)0 + attrib.offset);
+		glEnableVertexAttribArray(layout[a]);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	arena.vaos.emplace_back(layout, vao);
+	return vao;
+}
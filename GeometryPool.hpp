@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+ * GeometryPool suballocates vertex ranges from a few large OpenGL array buffers ("arenas"),
+ *  so that meshes loaded from different files end up in the same buffer, drawn through
+ *  the same vertex array object -- and so can be batched together (see Scene::submit).
+ *
+ * Each pool holds vertices of a single format; GeometryPool::shared(format) returns
+ *  the (global) pool for a format, creating it on first use.
+ *
+ * Ranges are addressed by arena and first vertex; 'start' values are what you pass
+ *  to glDrawArrays with the arena's vao bound.
+ */
+
+#include "GL.hpp"
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+struct GeometryPool {
+	//The location of an attribute within a vertex (in exactly the format wanted by glVertexAttribPointer):
+	struct Attrib {
+		GLint size = 0; //0 => not present
+		GLenum type = 0;
+		GLboolean normalized = GL_FALSE;
+		GLsizei stride = 0;
+		GLsizei offset = 0;
+
+		Attrib() = default;
+		Attrib(GLint size_, GLenum type_, GLboolean normalized_, GLsizei stride_, GLsizei offset_)
+		: size(size_), type(type_), normalized(normalized_), stride(stride_), offset(offset_) { }
+
+		bool operator==(Attrib const &o) const {
+			return size == o.size && type == o.type && normalized == o.normalized && stride == o.stride && offset == o.offset;
+		}
+	};
+
+	struct Format {
+		GLsizei stride = 0; //bytes per vertex
+		Attrib Position;
+		Attrib Normal;
+		Attrib Color;
+		Attrib TexCoord;
+
+		bool operator==(Format const &o) const {
+			return stride == o.stride && Position == o.Position && Normal == o.Normal && Color == o.Color && TexCoord == o.TexCoord;
+		}
+	};
+
+	//the pool for vertices in 'format' (created on first use):
+	static GeometryPool &shared(Format const &format);
+
+	GeometryPool(Format const &format);
+	~GeometryPool(); //deletes all arenas (and their vaos)
+	GeometryPool(GeometryPool const &) = delete;
+	GeometryPool &operator=(GeometryPool const &) = delete;
+
+	struct Range {
+		uint32_t arena = -1U; //-1U => nothing allocated
+		GLuint start = 0; //first vertex in arena
+		GLuint count = 0;
+	};
+
+	//copy 'count' vertices from 'data' into the pool:
+	Range allocate(GLuint count, void const *data);
+
+	//return a range to the pool (its vertices may be overwritten by later allocations):
+	void free(Range const &range);
+
+	//get a vertex array object that links an arena's buffer to a program's attributes:
+	// note: will throw if program has active attributes not in this pool's format
+	// note: vaos are shared between programs that use the same attribute locations, and belong to the pool.
+	GLuint vao_for_program(uint32_t arena, GLuint program);
+
+	//drop cached information about a program (call before deleting it, since GL may reuse the name):
+	static void forget_program(GLuint program);
+
+	//vertices per arena (allocations bigger than this get an arena of their own):
+	static constexpr GLuint ArenaVertices = 1 << 20;
+
+	//------ internals ------
+
+	Format format;
+
+	struct Arena {
+		GLuint buffer = 0;
+		GLuint capacity = 0; //in vertices
+		std::map< GLuint, GLuint > free; //unused (start, count) ranges, coalesced
+		//vaos made so far, keyed by the locations they bind Position, Normal, Color, and TexCoord to (-1 => not bound):
+		std::vector< std::pair< glm::ivec4, GLuint > > vaos;
+	};
+	std::vector< Arena > arenas;
+};
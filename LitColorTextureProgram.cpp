@@ -1,5 +1,8 @@
 #include "LitColorTextureProgram.hpp"
 
+#include "GeometryPool.hpp"
+#include "TextureLoader.hpp"
+#include "data_path.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -11,9 +14,11 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	//----- build the pipeline template -----
 	lit_color_texture_program_pipeline.program = ret->program;
 
-	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//per-object matrices come from the 'Object' uniform block:
+	lit_color_texture_program_pipeline.uses_object_block = true;
+
+	//depth-only version for Scene::depth_prepass:
+	lit_color_texture_program_pipeline.depth_program = ret->depth_program;
 
 	/* This will be used later if/when we build a light loop into the Scene:
 	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
@@ -23,21 +28,11 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
 	*/
 
-	//make a 1-pixel white texture to bind by default:
-	GLuint tex;
-	glGenTextures(1, &tex);
-
-	glBindTexture(GL_TEXTURE_2D, tex);
-	std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
+	//1-pixel white texture to bind by default:
+	// (TextureLoader binds a white placeholder right away, so this is usable before -- or even if -- the file loads)
+	TextureLoader::Texture const *white = TextureLoader::shared().load(data_path("white.png"), false);
 
-	lit_color_texture_program_pipeline.textures[0].texture = tex;
+	lit_color_texture_program_pipeline.textures[0].texture = white->texture;
 	lit_color_texture_program_pipeline.textures[0].target = GL_TEXTURE_2D;
 
 	return ret;
@@ -48,10 +43,13 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
-		"in vec4 Position;\n"
+		"layout(std140) uniform Object {\n"
+		"	mat4 OBJECT_TO_CLIP;\n"
+		"	mat4x3 OBJECT_TO_LIGHT;\n"
+		"	mat3 NORMAL_TO_LIGHT;\n"
+		"};\n"
+		"invariant gl_Position;\n"
+		"layout(location = 0) in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
 		"in vec2 TexCoord;\n"
@@ -75,6 +73,9 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"uniform vec3 LIGHT_DIRECTION;\n"
 		"uniform vec3 LIGHT_ENERGY;\n"
 		"uniform float LIGHT_CUTOFF;\n"
+		"uniform sampler2DArrayShadow SHADOW;\n"
+		"uniform int SHADOW_CASCADES;\n"
+		"uniform mat4 LIGHT_TO_SHADOW[4];\n"
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -82,6 +83,14 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"out vec4 fragColor;\n"
 		"void main() {\n"
 		"	vec3 n = normalize(normal);\n"
+		"	float lit = 1.0; //fraction of directional light that isn't shadowed (from the first cascade covering position) \n"
+		"	for (int i = 0; i < SHADOW_CASCADES; ++i) {\n"
+		"		vec4 s = LIGHT_TO_SHADOW[i] * vec4(position, 1.0);\n"
+		"		if (all(greaterThan(s.xyz, vec3(0.0))) && all(lessThan(s.xyz, vec3(1.0)))) {\n"
+		"			lit = texture(SHADOW, vec4(s.xy, float(i), s.z));\n"
+		"			break;\n"
+		"		}\n"
+		"	}\n"
 		"	vec3 e;\n"
 		"	if (LIGHT_TYPE == 0) { //point light \n"
 		"		vec3 l = (LIGHT_LOCATION - position);\n"
@@ -90,7 +99,8 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"		float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
 		"		e = nl * LIGHT_ENERGY;\n"
 		"	} else if (LIGHT_TYPE == 1) { //hemi light \n"
-		"		e = (dot(n,-LIGHT_DIRECTION) * 0.5 + 0.5) * LIGHT_ENERGY;\n"
+		"		float nl = dot(n,-LIGHT_DIRECTION);\n"
+		"		e = (max(0.0, nl) * lit + min(0.0, nl)) * 0.5 * LIGHT_ENERGY + 0.5 * LIGHT_ENERGY;\n"
 		"	} else if (LIGHT_TYPE == 2) { //spot light \n"
 		"		vec3 l = (LIGHT_LOCATION - position);\n"
 		"		float dis2 = dot(l,l);\n"
@@ -100,7 +110,7 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"		nl *= smoothstep(LIGHT_CUTOFF,mix(LIGHT_CUTOFF,1.0,0.1), c);\n"
 		"		e = nl * LIGHT_ENERGY;\n"
 		"	} else { //(LIGHT_TYPE == 3) //directional light \n"
-		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
+		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * lit * LIGHT_ENERGY;\n"
 		"	}\n"
 		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
 		"	fragColor = vec4(e*albedo.rgb, albedo.a);\n"
@@ -109,35 +119,68 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
 
+	//Depth-only program for the depth pre-pass.
+	// Computes gl_Position exactly as above (same expression, same attribute location, 'invariant')
+	// so that the shading pass can test against its depths with GL_EQUAL:
+	depth_program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"layout(std140) uniform Object {\n"
+		"	mat4 OBJECT_TO_CLIP;\n"
+		"	mat4x3 OBJECT_TO_LIGHT;\n"
+		"	mat3 NORMAL_TO_LIGHT;\n"
+		"};\n"
+		"invariant gl_Position;\n"
+		"layout(location = 0) in vec4 Position;\n"
+		"void main() {\n"
+		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"void main() {\n"
+		"}\n"
+	);
+	Scene::bind_uniform_blocks(depth_program);
+
 	//look up the locations of vertex attributes:
 	Position_vec4 = glGetAttribLocation(program, "Position");
 	Normal_vec3 = glGetAttribLocation(program, "Normal");
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
-	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
+	//attach the 'Object' uniform block to its binding point:
+	Scene::bind_uniform_blocks(program);
 
+	//look up the locations of uniforms:
 	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
 	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
 	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
 	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
 	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
+	SHADOW_CASCADES_int = glGetUniformLocation(program, "SHADOW_CASCADES");
+	LIGHT_TO_SHADOW_mat4_array = glGetUniformLocation(program, "LIGHT_TO_SHADOW");
 
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+	GLuint SHADOW_sampler2DArrayShadow = glGetUniformLocation(program, "SHADOW");
 
 	//set TEX to always refer to texture binding zero:
 	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+	glUniform1i(SHADOW_sampler2DArrayShadow, ShadowTextureUnit); //(outside the units Scene binds pipeline textures to)
+	glUniform1i(SHADOW_CASCADES_int, 0); //no shadows until someone supplies them
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
 }
 
 LitColorTextureProgram::~LitColorTextureProgram() {
+	GeometryPool::forget_program(depth_program);
+	glDeleteProgram(depth_program);
+	depth_program = 0;
+
+	GeometryPool::forget_program(program);
 	glDeleteProgram(program);
 	program = 0;
 }
@@ -10,6 +10,7 @@ struct LitColorTextureProgram {
 	~LitColorTextureProgram();
 
 	GLuint program = 0;
+	GLuint depth_program = 0; //writes depth only (for Scene::depth_prepass); Position at location 0, like 'program'
 
 	//Attribute (per-vertex variable) locations:
 	GLuint Position_vec4 = -1U;
@@ -17,20 +18,24 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
+	//Uniform blocks:
+	//'Object' - OBJECT_TO_CLIP, OBJECT_TO_LIGHT, NORMAL_TO_LIGHT (filled by Scene::draw; see Scene.hpp)
 
+	//Uniform (per-invocation variable) locations:
 	//lighting:
 	GLuint LIGHT_TYPE_int = -1U;
 	GLuint LIGHT_LOCATION_vec3 = -1U;
 	GLuint LIGHT_DIRECTION_vec3 = -1U;
 	GLuint LIGHT_ENERGY_vec3 = -1U;
 	GLuint LIGHT_CUTOFF_float = -1U;
+	//shadows (for directional and hemisphere lights; see CascadedShadowMap):
+	GLuint SHADOW_CASCADES_int = -1U; //number of cascades (0 => no shadows)
+	GLuint LIGHT_TO_SHADOW_mat4_array = -1U; //per cascade, light space (the space 'position' is lit in) to shadow texture coordinates
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
+	//TEXTURE4 - shadow map array (sampler2DArrayShadow), one layer per cascade:
+	static constexpr GLuint ShadowTextureUnit = Scene::Drawable::Pipeline::TextureCount;
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
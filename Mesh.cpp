@@ -3,17 +3,16 @@
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
-#include <set>
 #include <cstddef>
 
 MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
-
 	std::ifstream file(filename, std::ios::binary);
 
 	GLuint total = 0;
@@ -31,11 +30,6 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
 		read_chunk(file, "pnct", &data);
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
 		total = GLuint(data.size()); //store total for later checks on index
 
 		//store attrib locations:
@@ -43,6 +37,14 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
 		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
 		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+
+		GeometryPool::Format format;
+		format.stride = sizeof(Vertex);
+		format.Position = Position;
+		format.Normal = Normal;
+		format.Color = Color;
+		format.TexCoord = TexCoord;
+		pool = &GeometryPool::shared(format);
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
@@ -60,6 +62,32 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		std::vector< IndexEntry > index;
 		read_chunk(file, "idx0", &index);
 
+		//(optional) simplified versions of index entries:
+		struct LodEntry {
+			uint32_t mesh; //index entry this simplifies
+			uint32_t vertex_begin, vertex_end;
+			float max_size;
+		};
+		static_assert(sizeof(LodEntry) == 16, "Lod entry should be packed");
+
+		std::vector< LodEntry > lod_index;
+		if (peek_chunk(file, "lod0")) read_chunk(file, "lod0", &lod_index);
+
+		std::vector< std::vector< Mesh::Lod > > lods(index.size());
+		for (auto const &entry : lod_index) {
+			if (!(entry.mesh < index.size())) {
+				throw std::runtime_error("lod entry has out-of-range mesh index");
+			}
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
+				throw std::runtime_error("lod entry has out-of-range vertex start/count");
+			}
+			Mesh::Lod lod;
+			lod.start = entry.vertex_begin;
+			lod.count = entry.vertex_end - entry.vertex_begin;
+			lod.max_size = entry.max_size;
+			lods[entry.mesh].emplace_back(lod);
+		}
+
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
 				throw std::runtime_error("index entry has out-of-range name begin/end");
@@ -76,13 +104,65 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 				mesh.min = glm::min(mesh.min, data[v].Position);
 				mesh.max = glm::max(mesh.max, data[v].Position);
 			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			if (mesh.count >= 3) { //check if the mesh covers its bounding box:
+				glm::vec3 size = mesh.max - mesh.min;
+				float eps = 1e-4f * std::max(size.x, std::max(size.y, size.z));
+				//area of outward-facing triangles lying in each face (-x, +x, -y, +y, -z, +z):
+				float covered[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+				for (uint32_t v = entry.vertex_begin; v + 2 < entry.vertex_end; v += 3) {
+					glm::vec3 const &a = data[v].Position, &b = data[v+1].Position, &c = data[v+2].Position;
+					glm::vec3 area = 0.5f * glm::cross(b - a, c - a);
+					for (uint32_t axis = 0; axis < 3; ++axis) {
+						if (std::max(a[axis], std::max(b[axis], c[axis])) <= mesh.min[axis] + eps && area[axis] < 0.0f) covered[2*axis+0] -= area[axis];
+						if (std::min(a[axis], std::min(b[axis], c[axis])) >= mesh.max[axis] - eps && area[axis] > 0.0f) covered[2*axis+1] += area[axis];
+					}
+				}
+				float face_area[3] = { size.y * size.z, size.z * size.x, size.x * size.y };
+				mesh.occluder = std::max(face_area[0], std::max(face_area[1], face_area[2])) > 0.0f;
+				for (uint32_t f = 0; f < 6; ++f) {
+					if (covered[f] < 0.999f * face_area[f/2]) mesh.occluder = false;
+				}
 			}
+			mesh.lods = std::move(lods[&entry - &index[0]]);
+			meshes.emplace_back(std::move(name), std::move(mesh));
 		}
 	}
 
+	//sort by name, keeping only the first mesh (in file order) with each name:
+	std::stable_sort(meshes.begin(), meshes.end(), [](std::pair< std::string, Mesh > const &a, std::pair< std::string, Mesh > const &b) {
+		return a.first < b.first;
+	});
+	for (uint32_t i = 1; i < meshes.size(); ++i) {
+		if (meshes[i].first == meshes[i-1].first) {
+			std::cerr << "WARNING: mesh name '" + meshes[i].first + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+		}
+	}
+	meshes.erase(std::unique(meshes.begin(), meshes.end(), [](std::pair< std::string, Mesh > const &a, std::pair< std::string, Mesh > const &b) {
+		return a.first == b.first;
+	}), meshes.end());
+
+	//upload vertices to the pool, and make mesh ranges relative to the pool's arena:
+	range = pool->allocate(total, data.data());
+	buffer = pool->arenas[range.arena].buffer;
+	for (auto &[name, mesh] : meshes) {
+		mesh.start += range.start;
+		for (Mesh::Lod &lod : mesh.lods) {
+			lod.start += range.start;
+		}
+	}
+
+	//build the hash table used by find():
+	uint32_t slots = 16;
+	while (slots < 2 * meshes.size()) slots *= 2;
+	table.assign(slots, Slot());
+	for (uint32_t i = 0; i < meshes.size(); ++i) {
+		uint64_t hash = hash_name(meshes[i].first);
+		uint32_t s = uint32_t(hash) & (slots - 1);
+		while (table[s].index != -1U) s = (s + 1) & (slots - 1);
+		table[s].hash = hash;
+		table[s].index = i;
+	}
+
 	if (file.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
@@ -98,53 +178,41 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
-const Mesh &MeshBuffer::lookup(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
-		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
+const Mesh &MeshBuffer::lookup(std::string_view const &name) const {
+	uint32_t i = find(name);
+	if (i == -1U) {
+		throw std::runtime_error("Looking up mesh '" + std::string(name) + "' that doesn't exist.");
 	}
-	return f->second;
+	return meshes[i].second;
 }
 
-GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
-	//create a new vertex array object:
-	GLuint vao = 0;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	//Try to bind all attributes in this buffer:
-	std::set< GLuint > bound;
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	auto bind_attribute = [&](char const *name, MeshBuffer::Attrib const &attrib) {
-		if (attrib.size == 0) return; //don't bind empty attribs
-		GLint location = glGetAttribLocation(program, name);
-		if (location == -1) return; //can't bind missing attribs
-		glVertexAttribPointer(location, attrib.size, attrib.type, attrib.normalized, attrib.stride, (GLbyte *)0 + attrib.offset);
-		glEnableVertexAttribArray(location);
-		bound.insert(location);
-	};
-	bind_attribute("Position", Position);
-	bind_attribute("Normal", Normal);
-	bind_attribute("Color", Color);
-	bind_attribute("TexCoord", TexCoord);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	//Check that all active attributes were bound:
-	GLint active = 0;
-	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &active);
-	assert(active >= 0 && "Doesn't makes sense to have negative active attributes.");
-	for (GLuint i = 0; i < GLuint(active); ++i) {
-		GLchar name[100];
-		GLint size = 0;
-		GLenum type = 0;
-		glGetActiveAttrib(program, i, 100, NULL, &size, &type, name);
-		name[99] = '\0';
-		GLint location = glGetAttribLocation(program, name);
-		if (!bound.count(GLuint(location))) {
-			throw std::runtime_error("ERROR: active attribute '" + std::string(name) + "' in program is not bound.");
-		}
+uint32_t MeshBuffer::find(std::string_view const &name) const {
+	if (table.empty()) return -1U;
+	uint64_t hash = hash_name(name);
+	uint32_t mask = uint32_t(table.size()) - 1;
+	for (uint32_t s = uint32_t(hash) & mask; table[s].index != -1U; s = (s + 1) & mask) {
+		if (table[s].hash == hash && meshes[table[s].index].first == name) return table[s].index;
 	}
+	return -1U;
+}
+
+uint64_t MeshBuffer::hash_name(std::string_view const &name) {
+	//64-bit FNV-1a:
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c : name) {
+		hash ^= uint8_t(c);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
 
-	return vao;
+MeshBuffer::~MeshBuffer() {
+	pool->free(range);
+	range = GeometryPool::Range();
+	buffer = 0;
+}
+
+GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	assert(pool && range.arena != -1U);
+	return pool->vao_for_program(range.arena, program);
 }
@@ -4,16 +4,20 @@
  * In this code, "Mesh" is a range of vertices that should be sent through
  *  the OpenGL pipeline together.
  * A "MeshBuffer" holds a collection of such meshes (loaded from a file) in
- *  a single OpenGL array buffer. Individual meshes can be looked up by name
- *  using the MeshBuffer::lookup() function.
+ *  a range of a shared OpenGL array buffer (see GeometryPool), so meshes from
+ *  different files can be drawn without switching buffers. Individual meshes can be looked up by name
+ *  using the MeshBuffer::lookup() function (a hash table probe, so it is cheap
+ *  enough to call once per drawable when loading large scenes).
  *
  */
 
 #include "GL.hpp"
+#include "GeometryPool.hpp"
 #include <glm/glm.hpp>
-#include <map>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 struct Mesh {
@@ -27,41 +31,66 @@ struct Mesh {
 	//useful for debug visualization and (perhaps, eventually) collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//Does the mesh cover all six faces of its bounding box (with outward-facing triangles)?
+	// if so, the box is exactly what the mesh hides, so it can stand in for the mesh in occlusion culling:
+	bool occluder = false;
+
+	//Simplified versions of the mesh (from the file's optional 'lod0' chunk, written by mesh-simplify), coarser as index increases:
+	struct Lod {
+		GLuint start = 0; //index of first vertex
+		GLuint count = 0; //count of vertices
+		float max_size = 0.0f; //good enough when the mesh's projected bounding radius is below this fraction of the viewport half-height
+	};
+	std::vector< Lod > lods;
 };
 
 struct MeshBuffer {
 	//construct from a file:
 	// note: will throw if file fails to read.
+	// note: vertices are stored in the shared GeometryPool for their format, so Mesh::start values are offsets into that pool's arena.
 	MeshBuffer(std::string const &filename);
+	//returns the vertices to the pool:
+	~MeshBuffer();
+	MeshBuffer(MeshBuffer const &) = delete;
+	MeshBuffer &operator=(MeshBuffer const &) = delete;
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
-	const Mesh &lookup(std::string const &name) const;
+	const Mesh &lookup(std::string_view const &name) const;
+
+	//position of the mesh called 'name' in 'meshes' (or -1U if there isn't one):
+	uint32_t find(std::string_view const &name) const;
 	
-	//build a vertex array object that links this vbo to attributes to a program:
+	//get a vertex array object that links this vbo to attributes to a program:
 	// note: will throw if program defines attributes not contained in this buffer
+	// note: vaos belong to the GeometryPool and are shared by every MeshBuffer in the same arena
+	//  (and by programs that use the same attribute locations), so don't delete them yourself.
 	GLuint make_vao_for_program(GLuint program) const;
 
-	//This is the OpenGL vertex buffer object containing the mesh data:
+	//This is the OpenGL vertex buffer object containing the mesh data (shared with other MeshBuffers in the same arena):
 	GLuint buffer = 0;
 
 	//-- internals ---
 
-	//used by the lookup() function:
-	std::map< std::string, Mesh > meshes;
+	//all meshes, sorted by name (so they can be stepped through in order, e.g., by ShowMeshesMode):
+	std::vector< std::pair< std::string, Mesh > > meshes;
 
-	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
-	struct Attrib {
-		GLint size = 0;
-		GLenum type = 0;
-		GLboolean normalized = GL_FALSE;
-		GLsizei stride = 0;
-		GLsizei offset = 0;
-
-		Attrib() = default;
-		Attrib(GLint size_, GLenum type_, GLboolean normalized_, GLsizei stride_, GLsizei offset_)
-		: size(size_), type(type_), normalized(normalized_), stride(stride_), offset(offset_) { }
+	//used by find() and lookup(): open-addressed hash table of indices into 'meshes';
+	// size is a power of two, at most half full, and probing compares hashes before names:
+	struct Slot {
+		uint64_t hash = 0;
+		uint32_t index = -1U; //-1U => empty
 	};
+	std::vector< Slot > table;
+	static uint64_t hash_name(std::string_view const &name);
+
+	//where the vertices live:
+	GeometryPool *pool = nullptr;
+	GeometryPool::Range range;
+
+	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
+	typedef GeometryPool::Attrib Attrib;
 
 	Attrib Position;
 	Attrib Normal;
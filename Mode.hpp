@@ -5,6 +5,8 @@
 
 #include <memory>
 
+struct Scene;
+
 struct Mode : std::enable_shared_from_this< Mode > {
 	virtual ~Mode() { }
 
@@ -17,9 +19,23 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	// 'elapsed' is time in seconds since the last call to 'update'
 	virtual void update(float elapsed) { }
 
+	//snapshot is called after update, before draw:
+	// when main.cpp runs pipelined ('--pipelined'), the *next* update runs on a worker thread while draw runs,
+	// so a mode that returns true from can_pipeline() must have draw read only state copied here.
+	virtual void snapshot() { }
+	virtual bool can_pipeline() const { return false; }
+
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//set_benchmark_view is called before each update when benchmarking (see FrameBenchmark):
+	// 't' runs from 0 to 1 over the timed frames; place the view at 't' along some fixed path.
+	virtual void set_benchmark_view(float t) { }
+
+	//drawn_scene is the mode's main Scene (if any), whose draw settings command-line switches adjust
+	// and whose Scene::draw_stats a benchmark reports:
+	virtual Scene *drawn_scene() { return nullptr; }
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
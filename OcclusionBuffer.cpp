@@ -0,0 +1,231 @@
+#include "OcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define OCCLUSION_BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
+void OcclusionBuffer::clear() {
+	if (levels.empty()) {
+		uint32_t width = Width, height = Height;
+		while (true) {
+			levels.emplace_back();
+			levels.back().width = width;
+			levels.back().height = height;
+			levels.back().depth.resize(width * height);
+			if (width == 1 && height == 1) break;
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+	}
+	for (Level &level : levels) {
+		std::fill(level.depth.begin(), level.depth.end(), std::numeric_limits< float >::infinity());
+	}
+}
+
+//project the corners of [min,max] to (pixel x, pixel y, z / w); returns false if any corner is at or behind the eye:
+static bool project_box(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max, glm::vec3 (&screen)[8]) {
+	for (uint32_t c = 0; c < 8; ++c) {
+		glm::vec4 clip = object_to_clip * glm::vec4(
+			(c & 1) ? max.x : min.x,
+			(c & 2) ? max.y : min.y,
+			(c & 4) ? max.z : min.z,
+			1.0f
+		);
+		if (!(clip.w > 1e-5f)) return false;
+		float inv_w = 1.0f / clip.w;
+		screen[c] = glm::vec3(
+			(clip.x * inv_w * 0.5f + 0.5f) * float(OcclusionBuffer::Width),
+			(clip.y * inv_w * 0.5f + 0.5f) * float(OcclusionBuffer::Height),
+			clip.z * inv_w
+		);
+	}
+	return true;
+}
+
+bool OcclusionBuffer::add_occluder(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max) {
+	if (levels.empty()) clear();
+	if (min.x > max.x || min.y > max.y || min.z > max.z) return false;
+
+	glm::vec3 screen[8];
+	if (!project_box(object_to_clip, min, max, screen)) return false;
+
+	//Depth over the box's silhouette is where each pixel's ray enters the box, which (the box being convex)
+	// is the farthest of the front-facing face planes. Each plane's depth is affine in screen space:
+	struct Plane { float a, b, c; }; //depth = a * x + b * y + c (already pushed to its farthest within a pixel)
+	Plane planes[3];
+	uint32_t plane_count = 0;
+	{
+		//faces, wound counterclockwise as seen from outside (corner index bits are x,y,z):
+		static const uint8_t faces[6][3] = {
+			{0,4,6}, {1,3,7}, //-x, +x
+			{0,1,5}, {2,6,7}, //-y, +y
+			{0,2,3}, {4,5,7}, //-z, +z
+		};
+		for (auto const &face : faces) {
+			glm::vec3 n = glm::cross(screen[face[1]] - screen[face[0]], screen[face[2]] - screen[face[0]]);
+			if (!(n.z > 0.0f)) continue; //back-facing (or edge-on, in which case it doesn't limit depth)
+			if (plane_count == 3) break; //(a box shows at most three faces)
+			Plane &plane = planes[plane_count++];
+			plane.a = -n.x / n.z;
+			plane.b = -n.y / n.z;
+			plane.c = screen[face[0]].z - plane.a * screen[face[0]].x - plane.b * screen[face[0]].y;
+			plane.c += 0.5f * (std::abs(plane.a) + std::abs(plane.b));
+		}
+	}
+	if (plane_count == 0) return false;
+
+	//silhouette is the convex hull of the projected corners (monotone chain; comes out counterclockwise):
+	glm::vec2 hull[16];
+	uint32_t hull_count = 0;
+	{
+		glm::vec2 points[8];
+		for (uint32_t c = 0; c < 8; ++c) points[c] = glm::vec2(screen[c]);
+		std::sort(points, points + 8, [](glm::vec2 const &a, glm::vec2 const &b) {
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+		auto turn = [](glm::vec2 const &o, glm::vec2 const &a, glm::vec2 const &b) {
+			return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+		};
+		for (uint32_t i = 0; i < 8; ++i) { //lower hull
+			while (hull_count >= 2 && turn(hull[hull_count-2], hull[hull_count-1], points[i]) <= 0.0f) --hull_count;
+			hull[hull_count++] = points[i];
+		}
+		uint32_t lower = hull_count + 1;
+		for (uint32_t i = 7; i-- > 0; ) { //upper hull
+			while (hull_count >= lower && turn(hull[hull_count-2], hull[hull_count-1], points[i]) <= 0.0f) --hull_count;
+			hull[hull_count++] = points[i];
+		}
+		hull_count -= 1; //(last point repeats the first)
+	}
+	if (hull_count < 3) return false;
+
+	//edge functions, positive inside; pushed in so only fully-covered pixels pass:
+	struct Edge { float a, b, c; }; //inside if a * x + b * y + c >= 0
+	Edge edges[16];
+	glm::vec2 lo = hull[0], hi = hull[0];
+	for (uint32_t e = 0; e < hull_count; ++e) {
+		glm::vec2 const &p = hull[e];
+		glm::vec2 const &q = hull[(e + 1) % hull_count];
+		edges[e].a = -(q.y - p.y);
+		edges[e].b = (q.x - p.x);
+		edges[e].c = -(edges[e].a * p.x + edges[e].b * p.y);
+		edges[e].c -= 0.5f * (std::abs(edges[e].a) + std::abs(edges[e].b));
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+
+	//pixels that could be fully covered:
+	int32_t x0 = std::max(0, int32_t(std::floor(lo.x)));
+	int32_t x1 = std::min(int32_t(Width) - 1, int32_t(std::ceil(hi.x)) - 1);
+	int32_t y0 = std::max(0, int32_t(std::floor(lo.y)));
+	int32_t y1 = std::min(int32_t(Height) - 1, int32_t(std::ceil(hi.y)) - 1);
+	if (x0 > x1 || y0 > y1) return true; //too small (or off-screen) to cover any pixel
+
+	float *depth = levels[0].depth.data();
+	for (int32_t y = y0; y <= y1; ++y) {
+		float py = float(y) + 0.5f;
+		float *row = depth + y * Width;
+
+		//per-row constants:
+		float edge_c[16];
+		for (uint32_t e = 0; e < hull_count; ++e) edge_c[e] = edges[e].b * py + edges[e].c;
+		float plane_c[3];
+		for (uint32_t p = 0; p < plane_count; ++p) plane_c[p] = planes[p].b * py + planes[p].c;
+
+#ifdef OCCLUSION_BUFFER_SSE
+		__m128 const lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		__m128 const span_lo = _mm_set1_ps(float(x0));
+		__m128 const span_hi = _mm_set1_ps(float(x1 + 1));
+		for (int32_t x = x0 & ~3; x <= x1; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(px, span_lo), _mm_cmple_ps(px, span_hi));
+			for (uint32_t e = 0; e < hull_count; ++e) {
+				__m128 value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[e].a), px), _mm_set1_ps(edge_c[e]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(value, _mm_setzero_ps()));
+			}
+			if (_mm_movemask_ps(inside) == 0) continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[0].a), px), _mm_set1_ps(plane_c[0]));
+			for (uint32_t p = 1; p < plane_count; ++p) {
+				z = _mm_max_ps(z, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].a), px), _mm_set1_ps(plane_c[p])));
+			}
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 updated = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, updated), _mm_andnot_ps(inside, old)));
+		}
+#else
+		for (int32_t x = x0; x <= x1; ++x) {
+			float px = float(x) + 0.5f;
+			bool inside = true;
+			for (uint32_t e = 0; e < hull_count && inside; ++e) {
+				inside = (edges[e].a * px + edge_c[e] >= 0.0f);
+			}
+			if (!inside) continue;
+
+			float z = planes[0].a * px + plane_c[0];
+			for (uint32_t p = 1; p < plane_count; ++p) {
+				z = std::max(z, planes[p].a * px + plane_c[p]);
+			}
+			row[x] = std::min(row[x], z);
+		}
+#endif
+	}
+
+	return true;
+}
+
+void OcclusionBuffer::build_pyramid() {
+	if (levels.empty()) clear();
+	for (uint32_t l = 1; l < levels.size(); ++l) {
+		Level const &below = levels[l-1];
+		Level &level = levels[l];
+		for (uint32_t y = 0; y < level.height; ++y) {
+			uint32_t y_a = 2 * y, y_b = std::min(2 * y + 1, below.height - 1);
+			for (uint32_t x = 0; x < level.width; ++x) {
+				uint32_t x_a = 2 * x, x_b = std::min(2 * x + 1, below.width - 1);
+				level.depth[y * level.width + x] = std::max(
+					std::max(below.depth[y_a * below.width + x_a], below.depth[y_a * below.width + x_b]),
+					std::max(below.depth[y_b * below.width + x_a], below.depth[y_b * below.width + x_b])
+				);
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::occluded(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max) const {
+	if (levels.empty()) return false;
+	if (min.x > max.x || min.y > max.y || min.z > max.z) return false; //unknown bounds
+
+	glm::vec3 screen[8];
+	if (!project_box(object_to_clip, min, max, screen)) return false; //crosses the near plane
+
+	glm::vec3 lo = screen[0], hi = screen[0];
+	for (uint32_t c = 1; c < 8; ++c) {
+		lo = glm::min(lo, screen[c]);
+		hi = glm::max(hi, screen[c]);
+	}
+	if (hi.x < 0.0f || lo.x > float(Width) || hi.y < 0.0f || lo.y > float(Height)) return false; //(frustum culling's job)
+
+	//pixels touched:
+	uint32_t x0 = uint32_t(std::max(0, int32_t(std::floor(lo.x))));
+	uint32_t x1 = uint32_t(std::min(int32_t(Width) - 1, int32_t(std::floor(hi.x))));
+	uint32_t y0 = uint32_t(std::max(0, int32_t(std::floor(lo.y))));
+	uint32_t y1 = uint32_t(std::min(int32_t(Height) - 1, int32_t(std::floor(hi.y))));
+
+	//coarsest level needed for the rectangle to span at most 2x2 texels:
+	uint32_t l = 0;
+	while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)) ++l;
+
+	Level const &level = levels[l];
+	for (uint32_t y = (y0 >> l); y <= (y1 >> l); ++y) {
+		for (uint32_t x = (x0 >> l); x <= (x1 >> l); ++x) {
+			if (!(lo.z > level.depth[y * level.width + x])) return false;
+		}
+	}
+	return true;
+}
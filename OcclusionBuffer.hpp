@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * OcclusionBuffer is a small CPU-side depth buffer for occlusion culling:
+ *  - add_occluder() rasterizes the front of a box that is known to be solid
+ *    (e.g., a drawable whose mesh covers its bounding box; see Mesh::occluder)
+ *  - build_pyramid() reduces the depth buffer to a max-depth pyramid
+ *  - occluded() checks a bounding box against the pyramid
+ *
+ * Everything is conservative: occluders only write pixels they cover completely, at the
+ *  farthest depth they reach within each pixel, and boxes are compared by their nearest
+ *  corner against the farthest occluder depth over the pixels they touch.
+ * So occluded() may say "visible" for something hidden, but never the reverse.
+ *
+ * Rows are rasterized four pixels at a time with SSE (falling back to plain loops where SSE isn't available).
+ * Depths are clip-space z / w, so any projection (including infinite ones) works.
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct OcclusionBuffer {
+	static constexpr uint32_t Width = 256; //multiple of four
+	static constexpr uint32_t Height = 128;
+
+	//reset to empty (nothing occluded):
+	void clear();
+
+	//rasterize object-space box [min,max], as seen through 'object_to_clip';
+	// returns false (drawing nothing) if the box crosses the near plane or is degenerate:
+	bool add_occluder(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max);
+
+	//build the pyramid from the current occluders (call after adding occluders, before testing):
+	void build_pyramid();
+
+	//is object-space box [min,max] certainly hidden behind the occluders?
+	bool occluded(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max) const;
+
+	//------ internals ------
+
+	//levels[0] is the Width x Height depth buffer (nearest occluder depth per pixel);
+	// each following level is half the size (rounded up), holding the max of the 2x2 texels below it:
+	struct Level {
+		uint32_t width = 0, height = 0;
+		std::vector< float > depth;
+	};
+	std::vector< Level > levels;
+};
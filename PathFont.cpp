@@ -4,6 +4,8 @@
 #include "PathFont.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <cassert>
 
 PathFont::PathFont(uint32_t glyphs_,
 	const float *glyph_widths_,
@@ -14,11 +16,115 @@ PathFont::PathFont(uint32_t glyphs_,
 		glyph_char_starts(glyph_char_starts_), chars(chars_),
 		glyph_coord_starts(glyph_coord_starts_), coords(coords_) {
 
+	first_byte.fill(-1U);
+
+	trie.emplace_back(); //root node (never holds a glyph, since glyphs have at least one character)
+
 	for (uint32_t i = 0; i < glyphs; ++i) {
-		std::string str(reinterpret_cast< const char * >(chars + glyph_char_starts[i]), reinterpret_cast< const char * >(chars + glyph_char_starts[i+1]));
-		auto res = glyph_map.insert(std::make_pair(str, i));
-		if (!res.second) {
+		uint8_t const *begin = chars + glyph_char_starts[i];
+		uint8_t const *end = chars + glyph_char_starts[i+1];
+		if (begin == end) {
+			std::cerr << "WARNING: ignoring glyph " << i << " with no characters." << std::endl;
+			continue;
+		}
+
+		//walk (and extend) the trie along the glyph's characters:
+		uint32_t node = 0;
+		for (uint8_t const *c = begin; c != end; ++c) {
+			uint32_t next = -1U;
+			if (node == 0) {
+				next = first_byte[*c];
+			} else {
+				for (auto const &child : trie[node].children) {
+					if (child.first == *c) next = child.second;
+				}
+			}
+			if (next == -1U) {
+				next = uint32_t(trie.size());
+				trie.emplace_back();
+				if (node == 0) {
+					first_byte[*c] = next;
+				} else {
+					auto &children = trie[node].children;
+					children.emplace_back(*c, next);
+					std::sort(children.begin(), children.end());
+				}
+			}
+			node = next;
+		}
+
+		if (trie[node].glyph != -1U) {
+			std::string str(reinterpret_cast< const char * >(begin), reinterpret_cast< const char * >(end));
 			std::cerr << "WARNING: ignoring duplicate glyph for '" << str << "'." << std::endl;
+			continue;
 		}
+		trie[node].glyph = i;
 	}
 }
+
+uint32_t PathFont::lookup(char const *begin, char const *end, uint32_t *length) const {
+	assert(length);
+
+	uint32_t glyph = -1U;
+	*length = 0;
+
+	if (begin == end) return glyph;
+
+	uint32_t node = first_byte[uint8_t(*begin)];
+	char const *c = begin;
+	while (node != -1U) {
+		++c;
+		if (trie[node].glyph != -1U) {
+			glyph = trie[node].glyph;
+			*length = uint32_t(c - begin);
+		}
+		if (c == end) break;
+
+		//(multi-byte sequences are rare, so a linear scan of children is fine)
+		uint32_t next = -1U;
+		for (auto const &child : trie[node].children) {
+			if (child.first == uint8_t(*c)) {
+				next = child.second;
+				break;
+			}
+		}
+		node = next;
+	}
+
+	return glyph;
+}
+
+float PathFont::layout(std::string const &text, std::vector< glm::vec2 > *lines_) const {
+	assert(lines_);
+	auto &lines = *lines_;
+
+	float advance = 0.0f;
+
+	char const *begin = text.data();
+	char const *end = text.data() + text.size();
+	while (begin < end) {
+		uint32_t length = 0;
+		uint32_t glyph = lookup(begin, end, &length);
+		if (glyph == -1U) {
+			//missing! draw a tofu:
+			for (const auto &pt : {
+				glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
+				glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
+				glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
+				glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
+			}) {
+				lines.emplace_back(advance + pt.x, pt.y);
+			}
+			advance += 0.6f;
+			length = 1;
+		} else {
+			for (uint32_t c = glyph_coord_starts[glyph]; c + 1 < glyph_coord_starts[glyph+1]; c += 2) {
+				lines.emplace_back(advance + coords[c], coords[c+1]);
+			}
+			advance += glyph_widths[glyph];
+		}
+		begin += length;
+	}
+
+	return advance;
+}
@@ -12,7 +12,7 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <array>
 
 struct PathFont {
 	//meant to be intitialized with some pointers to constant data:
@@ -31,7 +31,22 @@ struct PathFont {
 	const float *coords = nullptr;
 
 	//computed in constructor:
-	std::map< std::string, uint32_t > glyph_map;
+	//glyph lookup trie over the bytes of each glyph's characters:
+	struct TrieNode {
+		uint32_t glyph = -1U; //glyph whose characters end at this node (-1U if none)
+		std::vector< std::pair< uint8_t, uint32_t > > children; //(next byte, node index), sorted by byte
+	};
+	std::vector< TrieNode > trie;
+	//the first level of the trie is a direct table, so single-byte glyphs are found with one array access:
+	std::array< uint32_t, 256 > first_byte; //node index for each first byte (-1U if no glyph starts with it)
+
+	//find the longest run of bytes at the start of [begin,end) that names a glyph:
+	// returns the glyph index (or -1U if there is none) and stores the length of the run in *length
+	uint32_t lookup(char const *begin, char const *end, uint32_t *length) const;
+
+	//lay out a string as line segments (pairs of points) in character-box units:
+	// missing glyphs are drawn as tofu; returns the total advance (along x)
+	float layout(std::string const &text, std::vector< glm::vec2 > *lines) const;
 
 	//the default font:
 	static PathFont font;
@@ -33,10 +33,22 @@ Load< Scene > phonebank_scene(LoadTagDefault, []() -> Scene const * {
 		drawable.pipeline.type = mesh.type;
 		drawable.pipeline.start = mesh.start;
 		drawable.pipeline.count = mesh.count;
+		for (Mesh::Lod const &lod : mesh.lods) {
+			drawable.pipeline.lods.emplace_back(Scene::Drawable::Pipeline::Lod{ lod.start, lod.count, lod.max_size });
+		}
+
+		drawable.min = mesh.min;
+		drawable.max = mesh.max;
+		drawable.occluder = mesh.occluder;
 
 	});
 });
 
+//flattened copy of the scene, instantiated each time a PlayMode starts:
+Load< Scene::Prefab > phonebank_prefab(LoadTagLate, []() -> Scene::Prefab const * {
+	return new Scene::Prefab(*phonebank_scene);
+});
+
 WalkMesh const *walkmesh = nullptr;
 Load< WalkMeshes > phonebank_walkmeshes(LoadTagDefault, []() -> WalkMeshes const * {
 	WalkMeshes *ret = new WalkMeshes(data_path("airshot.w"));
@@ -44,7 +56,9 @@ Load< WalkMeshes > phonebank_walkmeshes(LoadTagDefault, []() -> WalkMeshes const
 	return ret;
 });
 
-PlayMode::PlayMode() : scene(*phonebank_scene) {
+PlayMode::PlayMode() {
+	scene.instantiate(*phonebank_prefab);
+
 	//create a player transform:
 	scene.transforms.emplace_back();
 	player.transform = &scene.transforms.back();
@@ -163,6 +177,13 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 	return false;
 }
 
+void PlayMode::set_benchmark_view(float t) {
+	//stand in place and turn once around, looking level:
+	// (update() will tip the player to match the walkmesh's up-vector, as usual)
+	player.transform->rotation = glm::angleAxis(2.0f * 3.1415926f * t, glm::vec3(0.0f, 0.0f, 1.0f));
+	player.camera->transform->rotation = glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
 void PlayMode::update(float elapsed) {
 	if (game->game_over) {
 		return;	
@@ -311,18 +332,51 @@ void PlayMode::update(float elapsed) {
 	}
 }
 
+void PlayMode::snapshot() {
+	scene.save_transform_state(&transform_state);
+
+	//usually only transforms move, so their state can be copied straight across:
+	bool same_structure = render_scene.drawables.size() == scene.drawables.size()
+	                   && render_scene.cameras.size() == scene.cameras.size();
+	if (!same_structure || !render_scene.load_transform_state(transform_state)) {
+		//...but if objects were added (e.g., a model pool grew), rebuild the copy:
+		render_scene.set(scene);
+		auto render_it = render_scene.cameras.begin();
+		for (auto const &camera : scene.cameras) {
+			if (&camera == player.camera) render_camera = &*render_it;
+			++render_it;
+		}
+	}
+	assert(render_camera);
+
+	render_score = game->score;
+	render_game_over = game->game_over;
+}
+
 void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	//update camera aspect ratio for drawable:
-	player.camera->aspect = float(drawable_size.x) / float(drawable_size.y);
+	render_camera->aspect = float(drawable_size.x) / float(drawable_size.y);
+
+	glm::vec3 light_direction = glm::vec3(0.0f, 0.0f,-1.0f);
+
+	//bring shadow maps up to date (before touching the default framebuffer):
+	shadows.update(render_scene, *render_camera, light_direction);
 
 	//set up light type and position for lit_color_texture_program:
 	// TODO: consider using the Light(s) in the scene to do this
 	glUseProgram(lit_color_texture_program->program);
 	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
+	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(light_direction));
 	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
+	//(scene is drawn with world_to_light = identity, so world_to_shadow works as light_to_shadow)
+	glUniform1i(lit_color_texture_program->SHADOW_CASCADES_int, shadows.cascades);
+	glUniformMatrix4fv(lit_color_texture_program->LIGHT_TO_SHADOW_mat4_array, shadows.cascades, GL_FALSE, glm::value_ptr(shadows.world_to_shadow[0]));
 	glUseProgram(0);
 
+	glActiveTexture(GL_TEXTURE0 + LitColorTextureProgram::ShadowTextureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadows.texture);
+	glActiveTexture(GL_TEXTURE0);
+
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -330,12 +384,16 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
-	scene.draw(*player.camera);
+	render_scene.draw(*render_camera);
+
+	glActiveTexture(GL_TEXTURE0 + LitColorTextureProgram::ShadowTextureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glActiveTexture(GL_TEXTURE0);
 
 	/* In case you are wondering if your walkmesh is lining up with your scene, try:
 	{
 		glDisable(GL_DEPTH_TEST);
-		DrawLines lines(player.camera->make_projection() * glm::mat4(player.camera->transform->make_world_to_local()));
+		DrawLines lines(render_camera->make_projection() * glm::mat4(render_camera->transform->make_world_to_local()));
 		for (auto const &tri : walkmesh->triangles) {
 			lines.draw(walkmesh->vertices[tri.x], walkmesh->vertices[tri.y], glm::u8vec4(0x88, 0x00, 0xff, 0xff));
 			lines.draw(walkmesh->vertices[tri.y], walkmesh->vertices[tri.z], glm::u8vec4(0x88, 0x00, 0xff, 0xff));
@@ -344,45 +402,37 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	}
 	*/
 
-	if (game->game_over)  {
+	{ //overlay some text (hud_text only re-generates its vertices when the text or placement changes):
 		glDisable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
-		DrawLines lines(glm::mat4(
+		glm::mat4 world_to_clip = glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
 			0.0f, 1.0f, 0.0f, 0.0f,
 			0.0f, 0.0f, 1.0f, 0.0f,
 			0.0f, 0.0f, 0.0f, 1.0f
-		));
-
-		constexpr float text_size = 0.15f;
-		// calculated from pure experimentation since it doesn't make sense 
-		// logically
-		constexpr float text_size_divisor_for_mid = 5.3f;
-		std::string text = "Final Score: " + std::to_string(game->score); 
-		lines.draw_text(text,
-			glm::vec3(0.f - (static_cast<float>(text.length()) * text_size / text_size_divisor_for_mid), 0.f, 0.0),
-			glm::vec3(text_size, 0.0f, 0.0f), glm::vec3(0.0f, text_size, 0.0f),
-			Game::TEXT_COLOR);
-
-	} else { //use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
-		float aspect = float(drawable_size.x) / float(drawable_size.y);
-		DrawLines lines(glm::mat4(
-			1.0f / aspect, 0.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 0.0f, 1.0f
-		));
-
-		constexpr float H = 0.09f;
-		float ofs = 2.0f / drawable_size.y;
-		std::string text = "Current Score: " + std::to_string(game->score); 
-		lines.draw_text(text,
-			glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + + 0.1f * H + ofs, 0.0),
-			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-			Game::TEXT_COLOR);
+		);
+
+		if (render_game_over) {
+			constexpr float text_size = 0.15f;
+			// calculated from pure experimentation since it doesn't make sense 
+			// logically
+			constexpr float text_size_divisor_for_mid = 5.3f;
+			std::string text = "Final Score: " + std::to_string(render_score); 
+			hud_text.set(text,
+				glm::vec3(0.f - (static_cast<float>(text.length()) * text_size / text_size_divisor_for_mid), 0.f, 0.0),
+				glm::vec3(text_size, 0.0f, 0.0f), glm::vec3(0.0f, text_size, 0.0f),
+				Game::TEXT_COLOR);
+		} else {
+			constexpr float H = 0.09f;
+			float ofs = 2.0f / drawable_size.y;
+			std::string text = "Current Score: " + std::to_string(render_score); 
+			hud_text.set(text,
+				glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + + 0.1f * H + ofs, 0.0),
+				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+				Game::TEXT_COLOR);
+		}
 
-		
+		hud_text.draw(world_to_clip);
 	}
 	GL_ERRORS();
 }
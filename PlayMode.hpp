@@ -2,7 +2,9 @@
 
 #include "Game.hpp"
 #include "Scene.hpp"
+#include "CascadedShadowMap.hpp"
 #include "WalkMesh.hpp"
+#include "DrawLines.hpp"
 
 #include <glm/glm.hpp>
 
@@ -16,7 +18,11 @@ struct PlayMode : Mode {
 	//functions called by main loop:
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
 	virtual void update(float elapsed) override;
+	virtual void snapshot() override;
+	virtual bool can_pipeline() const override { return true; }
 	virtual void draw(glm::uvec2 const &drawable_size) override;
+	virtual void set_benchmark_view(float t) override;
+	virtual Scene *drawn_scene() override { return &render_scene; }
 
 	//----- game state -----
 
@@ -45,4 +51,18 @@ struct PlayMode : Mode {
 		//camera is at player's head and will be pitched by mouse up/down motion:
 		Scene::Camera *camera = nullptr;
 	} player;
+
+	//----- render state -----
+	//draw() reads only these copies (filled by snapshot()), so the next update() may run alongside it:
+	Scene render_scene;
+	Scene::Camera *render_camera = nullptr;
+	std::vector< Scene::TransformState > transform_state; //scratch space for snapshot()
+	float render_score = 0.0f;
+	bool render_game_over = false;
+
+	//shadows cast by the sun (static casters are cached; targets, rockets, and the bonus are redrawn as they move):
+	CascadedShadowMap shadows;
+
+	//score display:
+	TextLines hud_text;
 };
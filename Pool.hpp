@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ * Pool< T > hands out reusable objects (e.g., Scene::Transform pointers for projectile models):
+ *  - acquire() and release() are O(1) (a free list)
+ *  - when the free list runs dry, the pool applies its overflow policy:
+ *      Grow: call 'make' for a fresh object (up to 'max_size' objects in total, then act like Drop)
+ *      Drop: return T() (e.g., nullptr), counting the miss in 'dropped'
+ *      Assert: treat exhaustion as a programming error
+ */
+
+#include <functional>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+template< typename T >
+struct Pool {
+	enum Overflow {
+		Grow,
+		Drop,
+		Assert,
+	};
+
+	Pool(std::function< T() > const &make_ = nullptr, Overflow overflow_ = Grow, uint32_t max_size_ = -1U)
+		: make(make_), overflow(overflow_), max_size(max_size_) { }
+
+	//add an existing object to the pool (as free):
+	void add(T const &object) {
+		free_list.emplace_back(object);
+		total += 1;
+	}
+
+	//get a free object; returns T() if none is available and the overflow policy says not to make one:
+	T acquire() {
+		if (free_list.empty()) {
+			if (overflow == Assert) {
+				assert(0 && "Pool exhausted.");
+			} else if (overflow == Grow && make && total < max_size) {
+				total += 1;
+				live += 1;
+				return make();
+			}
+			dropped += 1;
+			return T();
+		}
+		T object = free_list.back();
+		free_list.pop_back();
+		live += 1;
+		return object;
+	}
+
+	//return an object from acquire() to the pool:
+	void release(T const &object) {
+		assert(live > 0);
+		live -= 1;
+		free_list.emplace_back(object);
+	}
+
+	uint32_t live_count() const { return live; }
+	uint32_t free_count() const { return uint32_t(free_list.size()); }
+
+	std::function< T() > make;
+	Overflow overflow;
+	uint32_t max_size;
+
+	std::vector< T > free_list;
+	uint32_t total = 0; //objects owned by the pool (live + free)
+	uint32_t live = 0; //objects currently acquired
+	uint32_t dropped = 0; //acquire() calls that came back empty-handed
+};
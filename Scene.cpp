@@ -2,10 +2,19 @@
 
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
+#include "Load.hpp"
+#include "WorkerPool.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 
 //-------------------------
 
@@ -79,6 +88,61 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //-------------------------
 
+//CPU-side copies of the uniform blocks described in Scene.hpp, laid out following std140 rules:
+// (mat4x3 and mat3 columns are each padded out to a vec4)
+struct FrameBlock {
+	glm::mat4 WORLD_TO_CLIP;
+	glm::vec4 WORLD_TO_LIGHT[4];
+};
+static_assert(sizeof(FrameBlock) == 16*4 + 16*4, "FrameBlock matches std140 layout.");
+
+struct ObjectBlock {
+	glm::mat4 OBJECT_TO_CLIP;
+	glm::vec4 OBJECT_TO_LIGHT[4];
+	glm::vec4 NORMAL_TO_LIGHT[3];
+};
+static_assert(sizeof(ObjectBlock) == 16*4 + 16*4 + 16*3, "ObjectBlock matches std140 layout.");
+
+//All scenes share one uniform buffer, which is re-filled on every draw() call:
+//n.b. declared static so they don't conflict with similarly named global variables elsewhere:
+static GLuint uniform_buffer = 0;
+static GLsizeiptr uniform_block_alignment = 256; //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT; 256 is the largest value the spec allows
+
+static Load< void > setup_uniform_buffer(LoadTagEarly, [](){
+	glGenBuffers(1, &uniform_buffer);
+	//for now, buffer will be un-filled.
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0) uniform_block_alignment = alignment;
+
+	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
+});
+
+//Overdraw measurement (all scenes share these queries, like the uniform buffer):
+// when measure_overdraw is set, submit() wraps its shading pass in a GL_SAMPLES_PASSED query;
+// results are read back a few frames later, once available, so they never stall the pipeline:
+struct OverdrawQuery {
+	GLuint query = 0;
+	GLint pixels = 0; //viewport size when the query was issued
+	bool pending = false;
+};
+static std::array< OverdrawQuery, 4 > overdraw_queries;
+static uint32_t overdraw_next = 0; //oldest query (and the next to issue)
+
+void Scene::bind_uniform_blocks(GLuint program) {
+	GLuint frame_index = glGetUniformBlockIndex(program, "Frame");
+	if (frame_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, frame_index, FrameBlockBinding);
+	}
+	GLuint object_index = glGetUniformBlockIndex(program, "Object");
+	if (object_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, object_index, ObjectBlockBinding);
+	}
+}
+
+//-------------------------
+
 
 void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
@@ -88,77 +152,418 @@ void Scene::draw(Camera const &camera) const {
 }
 
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	auto before = std::chrono::high_resolution_clock::now();
+	prepare(world_to_clip, world_to_light, &draw_prepared);
+	auto after_prepare = std::chrono::high_resolution_clock::now();
+	submit(draw_prepared);
+	auto after_submit = std::chrono::high_resolution_clock::now();
+
+	draw_stats.drawables = uint32_t(draw_prepared.drawables.size());
+	draw_stats.visible = uint32_t(draw_prepared.draw_list.size());
+	draw_stats.occluders = draw_prepared.occluders;
+	draw_stats.occluded = draw_prepared.occluded;
+	draw_stats.vertices = draw_stats.full_vertices = 0;
+	for (uint32_t i : draw_prepared.draw_list) {
+		Drawable::Pipeline const &pipeline = draw_prepared.drawables[i]->pipeline;
+		draw_stats.vertices += (draw_prepared.lods[i] == 0 ? pipeline.count : pipeline.lods[draw_prepared.lods[i] - 1].count);
+		draw_stats.full_vertices += pipeline.count;
+	}
+	draw_stats.prepare_ms = std::chrono::duration< float, std::milli >(after_prepare - before).count();
+	draw_stats.submit_ms = std::chrono::duration< float, std::milli >(after_submit - after_prepare).count();
+}
+
+uint32_t Scene::draw_depth(glm::mat4 const &world_to_clip, Filter filter) const {
+	depth_prepared.depth_only = true;
+	depth_prepared.filter = filter;
 
-	//Iterate through all drawables, sending each one to OpenGL:
+	prepare(world_to_clip, glm::mat4x3(1.0f), &depth_prepared);
+	submit(depth_prepared);
+
+	return uint32_t(depth_prepared.draw_list.size());
+}
+
+//is the object-space box [min,max] (possibly) inside the frustum of clip-space matrix 'object_to_clip'?
+static bool box_in_frustum(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max) {
+	if (min.x > max.x || min.y > max.y || min.z > max.z) return true; //unknown bounds; can't cull
+
+	glm::vec4 rows[4];
+	for (uint32_t r = 0; r < 4; ++r) {
+		rows[r] = glm::vec4(object_to_clip[0][r], object_to_clip[1][r], object_to_clip[2][r], object_to_clip[3][r]);
+	}
+	//clip planes -w <= x,y,z <= w, as object-space planes:
+	glm::vec4 planes[6] = {
+		rows[3] + rows[0], rows[3] - rows[0],
+		rows[3] + rows[1], rows[3] - rows[1],
+		rows[3] + rows[2], rows[3] - rows[2],
+	};
+	for (auto const &plane : planes) {
+		//box corner furthest along the plane normal:
+		glm::vec3 corner(
+			plane.x > 0.0f ? max.x : min.x,
+			plane.y > 0.0f ? max.y : min.y,
+			plane.z > 0.0f ? max.z : min.z
+		);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
+
+void Scene::prepare(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, Prepared *prepared_) const {
+	assert(prepared_);
+	Prepared &prepared = *prepared_;
+
+	prepared.world_to_clip = world_to_clip;
+	prepared.world_to_light = world_to_light;
+
+	//gather drawables that can actually be sent to OpenGL:
+	prepared.drawables.clear();
 	for (auto const &drawable : drawables) {
-		//Reference to drawable's pipeline for convenience:
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
-
 		//skip any drawables without a shader program set:
 		if (pipeline.program == 0) continue;
 		//skip any drawables that don't reference any vertex array:
 		if (pipeline.vao == 0) continue;
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
+		//skip any drawables the view doesn't include:
+		if (prepared.filter == StaticDrawables && drawable.dynamic) continue;
+		if (prepared.filter == DynamicDrawables && !drawable.dynamic) continue;
 
+		assert(drawable.transform); //drawables *must* have a transform
+		prepared.drawables.emplace_back(&drawable);
+	}
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
-
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+	prepared.matrices.resize(prepared.drawables.size());
+	prepared.visible.resize(prepared.drawables.size());
+	prepared.sizes.resize(prepared.drawables.size());
+	prepared.depths.resize(prepared.drawables.size());
+	prepared.lods.resize(prepared.drawables.size());
+
+	//clip-space y per unit of world-space distance (so a world-space radius r at clip w covers r * clip_y_scale / w of the viewport half-height):
+	float const clip_y_scale = glm::length(glm::vec3(world_to_clip[0][1], world_to_clip[1][1], world_to_clip[2][1]));
+
+	//compute matrices + visibility + level of detail in parallel (each chunk writes only its own entries):
+	WorkerPool::shared().parallel_for(uint32_t(prepared.drawables.size()), 256, [&](uint32_t begin, uint32_t end){
+		for (uint32_t i = begin; i < end; ++i) {
+			Drawable const &drawable = *prepared.drawables[i];
+			ObjectMatrices &m = prepared.matrices[i];
+
+			glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+			m.object_to_clip = world_to_clip * glm::mat4(object_to_world);
+			m.object_to_light = world_to_light * glm::mat4(object_to_world);
+			m.normal_to_light = glm::inverse(glm::transpose(glm::mat3(m.object_to_light)));
+
+			prepared.visible[i] = box_in_frustum(m.object_to_clip, drawable.min, drawable.max) ? 1 : 0;
+
+			//view depth and projected size of bounding sphere:
+			float &size = prepared.sizes[i];
+			size = 0.0f;
+			prepared.depths[i] = m.object_to_clip[3].w; //(of origin, if bounds are unknown)
+			if (prepared.visible[i] && drawable.min.x <= drawable.max.x) {
+				glm::vec4 center = m.object_to_clip * glm::vec4(0.5f * (drawable.min + drawable.max), 1.0f);
+				prepared.depths[i] = center.w;
+				float scale = std::max(glm::length(object_to_world[0]), std::max(glm::length(object_to_world[1]), glm::length(object_to_world[2])));
+				float radius = 0.5f * glm::length(drawable.max - drawable.min) * scale;
+				size = (center.w > 0.0f ? radius * clip_y_scale / center.w : std::numeric_limits< float >::infinity());
+			}
 
-		//Configure program uniforms:
+			//pick level of detail from projected size:
+			std::vector< Drawable::Pipeline::Lod > const &lods = drawable.pipeline.lods;
+			uint32_t lod = std::min(drawable.lod, uint32_t(lods.size()));
+			if (!lods.empty() && prepared.visible[i] && drawable.min.x <= drawable.max.x) {
+				while (lod < lods.size() && size < lods[lod].max_size * (1.0f - lod_hysteresis)) ++lod;
+				while (lod > 0 && size > lods[lod-1].max_size * (1.0f + lod_hysteresis)) --lod;
+				if (!prepared.depth_only) drawable.lod = lod; //(depth-only views don't get a say in hysteresis)
+			}
+			prepared.lods[i] = lod;
+		}
+	});
+
+	prepared.occluders = 0;
+	prepared.occluded = 0;
+	if (occlusion_culling) {
+		//rasterize the biggest visible occluders:
+		std::vector< std::pair< float, uint32_t > > candidates; //(size, index)
+		for (uint32_t i = 0; i < prepared.drawables.size(); ++i) {
+			if (prepared.visible[i] && prepared.drawables[i]->occluder) candidates.emplace_back(prepared.sizes[i], i);
+		}
+		if (candidates.size() > max_occluders) {
+			std::nth_element(candidates.begin(), candidates.begin() + max_occluders, candidates.end(), std::greater< std::pair< float, uint32_t > >());
+			candidates.resize(max_occluders);
+		}
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+		prepared.occlusion.clear();
+		for (auto const &[size, i] : candidates) {
+			Drawable const &drawable = *prepared.drawables[i];
+			if (prepared.occlusion.add_occluder(prepared.matrices[i].object_to_clip, drawable.min, drawable.max)) prepared.occluders += 1;
+		}
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+		//cull drawables hidden behind them:
+		if (prepared.occluders > 0) {
+			prepared.occlusion.build_pyramid();
+			std::atomic< uint32_t > occluded(0);
+			WorkerPool::shared().parallel_for(uint32_t(prepared.drawables.size()), 256, [&](uint32_t begin, uint32_t end){
+				uint32_t count = 0;
+				for (uint32_t i = begin; i < end; ++i) {
+					if (!prepared.visible[i]) continue;
+					Drawable const &drawable = *prepared.drawables[i];
+					if (prepared.occlusion.occluded(prepared.matrices[i].object_to_clip, drawable.min, drawable.max)) {
+						prepared.visible[i] = 0;
+						count += 1;
+					}
+				}
+				occluded += count;
+			});
+			prepared.occluded = occluded;
 		}
+	}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+	prepared.draw_list.clear();
+	for (uint32_t i = 0; i < prepared.drawables.size(); ++i) {
+		if (prepared.visible[i]) prepared.draw_list.emplace_back(i);
+	}
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
-		}
+	if (sort_front_to_back) {
+		//nearest first, so nearer surfaces fill the depth buffer before farther ones are shaded:
+		// (stable, so drawables at equal depth -- e.g., sharing a transform -- stay together for batching)
+		std::stable_sort(prepared.draw_list.begin(), prepared.draw_list.end(), [&](uint32_t a, uint32_t b) {
+			return prepared.depths[a] < prepared.depths[b];
+		});
+	}
+}
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
-		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+void Scene::submit(Prepared const &prepared) const {
+	//round block sizes up so every block starts at a legal offset for glBindBufferRange:
+	auto aligned = [](GLsizeiptr size) {
+		return (size + uniform_block_alignment - 1) / uniform_block_alignment * uniform_block_alignment;
+	};
+	GLsizeiptr const frame_stride = aligned(sizeof(FrameBlock));
+	GLsizeiptr const object_stride = aligned(sizeof(ObjectBlock));
+
+	//Pack matrices for all uniform-block drawables into one buffer:
+	std::vector< char > &blocks = submit_blocks;
+	blocks.clear();
+	for (uint32_t i : prepared.draw_list) {
+		if (!prepared.drawables[i]->pipeline.uses_object_block) continue;
+
+		if (blocks.empty()) {
+			//per-frame block goes first:
+			blocks.resize(frame_stride);
+			FrameBlock frame;
+			frame.WORLD_TO_CLIP = prepared.world_to_clip;
+			for (uint32_t c = 0; c < 4; ++c) frame.WORLD_TO_LIGHT[c] = glm::vec4(prepared.world_to_light[c], 0.0f);
+			std::memcpy(blocks.data(), &frame, sizeof(frame));
 		}
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+		ObjectMatrices const &m = prepared.matrices[i];
+		ObjectBlock object;
+		object.OBJECT_TO_CLIP = m.object_to_clip;
+		for (uint32_t c = 0; c < 4; ++c) object.OBJECT_TO_LIGHT[c] = glm::vec4(m.object_to_light[c], 0.0f);
+		for (uint32_t c = 0; c < 3; ++c) object.NORMAL_TO_LIGHT[c] = glm::vec4(m.normal_to_light[c], 0.0f);
+
+		size_t offset = blocks.size();
+		blocks.resize(offset + object_stride);
+		std::memcpy(blocks.data() + offset, &object, sizeof(object));
+	}
 
-		//set up textures:
+	if (!blocks.empty()) {
+		//upload blocks, orphaning the previous contents so the driver needn't wait on draws still reading them:
+		glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, blocks.size(), blocks.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, uniform_buffer, 0, sizeof(FrameBlock));
+	}
+	//Drawables that share a transform and all pipeline state would be drawn with the same uniforms,
+	// so runs of them go out as one glMultiDrawArrays (their meshes live in shared GeometryPool arenas, so they usually share a vao):
+	auto batches_with = [](Drawable const &a, Drawable const &b) {
+		Drawable::Pipeline const &pa = a.pipeline;
+		Drawable::Pipeline const &pb = b.pipeline;
+		if (a.transform != b.transform) return false;
+		if (pa.program != pb.program || pa.depth_program != pb.depth_program || pa.vao != pb.vao || pa.type != pb.type) return false;
+		if (pa.uses_object_block != pb.uses_object_block) return false;
+		if (pa.set_uniforms || pb.set_uniforms) return false; //(can't tell what these do)
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
-			}
+			if (pa.textures[i].texture != pb.textures[i].texture || pa.textures[i].target != pb.textures[i].target) return false;
+		}
+		return true;
+	};
+	std::vector< GLint > &batch_firsts = submit_batch_firsts;
+	std::vector< GLsizei > &batch_counts = submit_batch_counts;
+	uint32_t draw_calls = 0;
+
+	//(optionally) count the samples that get shaded:
+	OverdrawQuery *active_query = nullptr;
+	auto begin_overdraw_query = [&]() {
+		if (!measure_overdraw) return;
+
+		//collect finished results, oldest first:
+		for (uint32_t i = 0; i < overdraw_queries.size(); ++i) {
+			OverdrawQuery &q = overdraw_queries[(overdraw_next + i) % overdraw_queries.size()];
+			if (!q.pending) continue;
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) break;
+			GLuint samples = 0;
+			glGetQueryObjectuiv(q.query, GL_QUERY_RESULT, &samples);
+			q.pending = false;
+			draw_stats.shaded_samples = samples;
+			draw_stats.overdraw = (q.pixels > 0 ? float(samples) / float(q.pixels) : 0.0f);
 		}
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+		OverdrawQuery &q = overdraw_queries[overdraw_next];
+		if (q.pending) return; //all queries still in flight; skip measuring this frame
+		if (q.query == 0) glGenQueries(1, &q.query);
+		GLint viewport[4] = {0, 0, 0, 0};
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		q.pixels = viewport[2] * viewport[3];
+		glBeginQuery(GL_SAMPLES_PASSED, q.query);
+		active_query = &q;
+	};
+	auto end_overdraw_query = [&]() {
+		if (!active_query) return;
+		glEndQuery(GL_SAMPLES_PASSED);
+		active_query->pending = true;
+		active_query = nullptr;
+		overdraw_next = (overdraw_next + 1) % overdraw_queries.size();
+	};
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
+	//Send visible drawables to OpenGL (depth_only => for the pre-pass):
+	auto draw_pass = [&](bool depth_only) {
+		//offset of the next drawable's ObjectBlock:
+		GLintptr object_offset = frame_stride;
+
+		//program and vao bound so far (drawables loaded from the same MeshBuffer share vaos, so this often saves a bind):
+		GLuint bound_program = 0;
+		GLuint bound_vao = 0;
+
+		//Iterate through visible drawables, sending each one (or batch) to OpenGL:
+		for (uint32_t n = 0; n < prepared.draw_list.size(); ) {
+			uint32_t d = prepared.draw_list[n];
+			Drawable const &drawable = *prepared.drawables[d];
+
+			//Reference to drawable's pipeline for convenience:
+			Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+
+			//Set shader program (in the depth pass, the pipeline's depth-only program if it has one):
+			bool use_depth_program = (depth_only && pipeline.uses_object_block && pipeline.depth_program != 0);
+			GLuint program = (use_depth_program ? pipeline.depth_program : pipeline.program);
+			if (program != bound_program) {
+				glUseProgram(program);
+				bound_program = program;
 			}
+
+			//Set attribute sources:
+			if (pipeline.vao != bound_vao) {
+				glBindVertexArray(pipeline.vao);
+				bound_vao = pipeline.vao;
+			}
+
+			//Configure program uniforms:
+
+			if (pipeline.uses_object_block) {
+				//matrices were already packed above; just point the Object block at them:
+				glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, uniform_buffer, object_offset, sizeof(ObjectBlock));
+				object_offset += object_stride;
+			} else {
+				ObjectMatrices const &m = prepared.matrices[d];
+
+				//OBJECT_TO_CLIP takes vertices from object space to clip space:
+				if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+					glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(m.object_to_clip));
+				}
+
+				//OBJECT_TO_CLIP takes vertices from object space to light space:
+				if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+					glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(m.object_to_light));
+				}
+
+				//NORMAL_TO_CLIP takes normals from object space to light space:
+				if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
+					glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(m.normal_to_light));
+				}
+			}
+
+			//set any requested custom uniforms:
+			if (pipeline.set_uniforms && !use_depth_program) pipeline.set_uniforms();
+
+			//set up textures:
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount && !use_depth_program; ++i) {
+				if (pipeline.textures[i].texture != 0) {
+					glActiveTexture(GL_TEXTURE0 + i);
+					glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+				}
+			}
+
+			//gather vertex ranges (at the levels of detail picked by prepare()) for this drawable and any that batch with it:
+			batch_firsts.clear();
+			batch_counts.clear();
+			do {
+				uint32_t b = prepared.draw_list[n];
+				Drawable::Pipeline const &bp = prepared.drawables[b]->pipeline;
+				if (prepared.lods[b] == 0) {
+					batch_firsts.emplace_back(bp.start);
+					batch_counts.emplace_back(bp.count);
+				} else {
+					Drawable::Pipeline::Lod const &lod = bp.lods[prepared.lods[b] - 1];
+					batch_firsts.emplace_back(lod.start);
+					batch_counts.emplace_back(lod.count);
+				}
+				//(batched drawables share the first one's matrices, so skip over their packed blocks)
+				if (b != d && bp.uses_object_block) object_offset += object_stride;
+				++n;
+			} while (n < prepared.draw_list.size() && batches_with(drawable, *prepared.drawables[prepared.draw_list[n]]));
+
+			//draw the object(s):
+			if (batch_firsts.size() == 1) {
+				glDrawArrays(pipeline.type, batch_firsts[0], batch_counts[0]);
+			} else {
+				glMultiDrawArrays(pipeline.type, batch_firsts.data(), batch_counts.data(), GLsizei(batch_firsts.size()));
+			}
+			draw_calls += 1;
+
+			//un-bind textures:
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount && !use_depth_program; ++i) {
+				if (pipeline.textures[i].texture != 0) {
+					glActiveTexture(GL_TEXTURE0 + i);
+					glBindTexture(pipeline.textures[i].target, 0);
+				}
+			}
+			glActiveTexture(GL_TEXTURE0);
+
 		}
-		glActiveTexture(GL_TEXTURE0);
+	};
 
+	if (prepared.depth_only) {
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		draw_pass(true);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	} else if (depth_prepass && !prepared.draw_list.empty()) {
+		//lay down depth only...
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		draw_pass(true);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		//...then shade just the surfaces that ended up in front:
+		GLint depth_func = GL_LESS;
+		glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+		GLboolean depth_mask = GL_TRUE;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		begin_overdraw_query();
+		draw_pass(false);
+		end_overdraw_query();
+		glDepthMask(depth_mask);
+		glDepthFunc(depth_func);
+	} else {
+		begin_overdraw_query();
+		draw_pass(false);
+		end_overdraw_query();
 	}
 
+	if (!prepared.depth_only) draw_stats.draw_calls = draw_calls;
+
 	glUseProgram(0);
 	glBindVertexArray(0);
 
@@ -166,107 +571,106 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 }
 
 
-void Scene::load(std::string const &filename,
-	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
-
+Scene::FileData::FileData(std::string const &filename_) : filename(filename_) {
 	std::ifstream file(filename, std::ios::binary);
 
-	std::vector< char > names;
 	read_chunk(file, "str0", &names);
-
-	struct HierarchyEntry {
-		uint32_t parent;
-		uint32_t name_begin;
-		uint32_t name_end;
-		glm::vec3 position;
-		glm::quat rotation;
-		glm::vec3 scale;
-	};
-	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
 	read_chunk(file, "xfh0", &hierarchy);
-
-	struct MeshEntry {
-		uint32_t transform;
-		uint32_t name_begin;
-		uint32_t name_end;
-	};
-	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
 	read_chunk(file, "msh0", &meshes);
-
-	struct CameraEntry {
-		uint32_t transform;
-		char type[4]; //"pers" or "orth"
-		float data; //fov in degrees for 'pers', scale for 'orth'
-		float clip_near, clip_far;
-	};
-	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > cameras;
 	read_chunk(file, "cam0", &cameras);
-
-	struct LightEntry {
-		uint32_t transform;
-		char type;
-		glm::u8vec3 color;
-		float energy;
-		float distance;
-		float fov;
-	};
-	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > lights;
 	read_chunk(file, "lmp0", &lights);
 
+	//keep whatever follows for load_extra():
+	extra.assign(std::istreambuf_iterator< char >(file), std::istreambuf_iterator< char >());
 
 	//--------------------------------
-	//Now that file is loaded, create transforms for hierarchy entries:
+	//validate everything up front, so instantiation can't fail partway:
 
-	std::vector< Transform * > hierarchy_transforms;
-	hierarchy_transforms.reserve(hierarchy.size());
+	for (uint32_t i = 0; i < hierarchy.size(); ++i) {
+		auto const &h = hierarchy[i];
+		if (h.parent != -1U && h.parent >= i) {
+			throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
+		}
+		if (!(h.name_begin <= h.name_end && h.name_end <= names.size())) {
+			throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
+		}
+	}
 
-	for (auto const &h : hierarchy) {
+	for (auto const &m : meshes) {
+		if (m.transform >= hierarchy.size()) {
+			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid transform index (" + std::to_string(m.transform) + ")");
+		}
+		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
+			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
+		}
+	}
+
+	for (auto const &c : cameras) {
+		if (c.transform >= hierarchy.size()) {
+			throw std::runtime_error("scene file '" + filename + "' contains camera entry with invalid transform index (" + std::to_string(c.transform) + ")");
+		}
+	}
+
+	for (auto const &l : lights) {
+		if (l.transform >= hierarchy.size()) {
+			throw std::runtime_error("scene file '" + filename + "' contains lamp entry with invalid transform index (" + std::to_string(l.transform) + ")");
+		}
+	}
+}
+
+bool Scene::instantiate(FileData const &data, Instantiation *progress_,
+	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable,
+	uint32_t max_entries) {
+	assert(progress_);
+	Instantiation &progress = *progress_;
+	if (progress.done) return true;
+
+	auto const &names = data.names;
+	auto &hierarchy_transforms = progress.transforms;
+
+	uint32_t const mesh_begin = uint32_t(data.hierarchy.size());
+	uint32_t const camera_begin = mesh_begin + uint32_t(data.meshes.size());
+	uint32_t const light_begin = camera_begin + uint32_t(data.cameras.size());
+	uint32_t const end = light_begin + uint32_t(data.lights.size());
+
+	uint32_t stop = (end - progress.next < max_entries ? end : progress.next + max_entries);
+
+	//create transforms for hierarchy entries:
+	if (progress.next < mesh_begin) {
+		hierarchy_transforms.reserve(data.hierarchy.size());
+		if (!progress.names) progress.names = std::make_shared< std::vector< char > const >(names);
+	}
+	std::vector< NamedTransform > named;
+	for (; progress.next < std::min(stop, mesh_begin); ++progress.next) {
+		auto const &h = data.hierarchy[progress.next];
 		transforms.emplace_back();
 		Transform *t = &transforms.back();
 		if (h.parent != -1U) {
-			if (h.parent >= hierarchy_transforms.size()) {
-				throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
-			}
 			t->parent = hierarchy_transforms[h.parent];
 		}
 
-		if (h.name_begin <= h.name_end && h.name_end <= names.size()) {
-			t->name = std::string(names.begin() + h.name_begin, names.begin() + h.name_end);
-		} else {
-				throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
-		}
+		t->name = std::string(names.begin() + h.name_begin, names.begin() + h.name_end);
 
 		t->position = h.position;
 		t->rotation = h.rotation;
 		t->scale = h.scale;
 
 		hierarchy_transforms.emplace_back(t);
+		named.emplace_back(NamedTransform{ std::string_view(progress.names->data() + h.name_begin, h.name_end - h.name_begin), t });
 	}
-	assert(hierarchy_transforms.size() == hierarchy.size());
+	if (!named.empty()) add_to_name_index(progress.names, std::move(named));
 
-	for (auto const &m : meshes) {
-		if (m.transform >= hierarchy_transforms.size()) {
-			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid transform index (" + std::to_string(m.transform) + ")");
-		}
-		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
-			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
-		}
+	for (; progress.next < std::min(stop, camera_begin); ++progress.next) {
+		auto const &m = data.meshes[progress.next - mesh_begin];
 		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
 
 		if (on_drawable) {
 			on_drawable(*this, hierarchy_transforms[m.transform], name);
 		}
-
 	}
 
-	for (auto const &c : cameras) {
-		if (c.transform >= hierarchy_transforms.size()) {
-			throw std::runtime_error("scene file '" + filename + "' contains camera entry with invalid transform index (" + std::to_string(c.transform) + ")");
-		}
+	for (; progress.next < std::min(stop, light_begin); ++progress.next) {
+		auto const &c = data.cameras[progress.next - camera_begin];
 		if (std::string(c.type, 4) != "pers") {
 			std::cout << "Ignoring non-perspective camera (" + std::string(c.type, 4) + ") stored in file." << std::endl;
 			continue;
@@ -278,10 +682,8 @@ void Scene::load(std::string const &filename,
 		//N.b. far plane is ignored because cameras use infinite perspective matrices.
 	}
 
-	for (auto const &l : lights) {
-		if (l.transform >= hierarchy_transforms.size()) {
-			throw std::runtime_error("scene file '" + filename + "' contains lamp entry with invalid transform index (" + std::to_string(l.transform) + ")");
-		}
+	for (; progress.next < stop; ++progress.next) {
+		auto const &l = data.lights[progress.next - light_begin];
 		if (l.type == 'p') {
 			//good
 		} else if (l.type == 'h') {
@@ -301,15 +703,27 @@ void Scene::load(std::string const &filename,
 		light->spot_fov = l.fov / 180.0f * 3.1415926f; //FOV is stored in degrees; convert to radians.
 	}
 
+	if (progress.next < end) return false;
+
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	std::istringstream extra(std::string(data.extra.begin(), data.extra.end()));
+	load_extra(extra, names, hierarchy_transforms);
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
+	if (extra.peek() != EOF) {
+		std::cerr << "WARNING: trailing data in scene file '" << data.filename << "'" << std::endl;
 	}
 
+	progress.done = true;
+	return true;
+}
 
+void Scene::load(std::string const &filename,
+	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 
+	FileData data(filename);
+	Instantiation progress;
+	instantiate(data, &progress, on_drawable);
+	assert(progress.done);
 }
 
 //-------------------------
@@ -333,6 +747,7 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
 
 	transform_to_transform.clear();
+	transform_to_transform.reserve(other.transforms.size() + 1);
 
 	//null transform maps to itself:
 	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
@@ -357,6 +772,13 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		t.parent = transform_to_transform.at(t.parent);
 	}
 
+	//copy other's name index (sharing its name blobs), updating transform pointers:
+	name_blobs = other.name_blobs;
+	name_index = other.name_index;
+	for (auto &n : name_index) {
+		n.transform = transform_to_transform.at(n.transform);
+	}
+
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
@@ -375,3 +797,167 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		l.transform = transform_to_transform.at(l.transform);
 	}
 }
+
+//-------------------------
+
+void Scene::save_transform_state(std::vector< TransformState > *state_) const {
+	assert(state_);
+	auto &state = *state_;
+	state.resize(transforms.size());
+	auto out = state.begin();
+	for (auto const &t : transforms) {
+		out->position = t.position;
+		out->rotation = t.rotation;
+		out->scale = t.scale;
+		++out;
+	}
+}
+
+bool Scene::load_transform_state(std::vector< TransformState > const &state) {
+	if (state.size() != transforms.size()) return false;
+	auto in = state.begin();
+	for (auto &t : transforms) {
+		t.position = in->position;
+		t.rotation = in->rotation;
+		t.scale = in->scale;
+		++in;
+	}
+	return true;
+}
+
+//-------------------------
+
+Scene::Prefab::Prefab(Scene const &scene) {
+	//transform -> index (only needed once, when building the prefab):
+	std::unordered_map< Transform const *, uint32_t > index;
+	index.reserve(scene.transforms.size() + 1);
+	index.emplace(nullptr, -1U);
+
+	std::vector< char > names_;
+	transforms.reserve(scene.transforms.size());
+	for (auto const &t : scene.transforms) {
+		auto f = index.find(t.parent);
+		if (f == index.end()) {
+			throw std::runtime_error("Can't make a prefab from a scene whose transforms are listed before their parents.");
+		}
+		TransformEntry entry;
+		entry.parent = f->second;
+		entry.name_begin = uint32_t(names_.size());
+		names_.insert(names_.end(), t.name.begin(), t.name.end());
+		entry.name_end = uint32_t(names_.size());
+		entry.position = t.position;
+		entry.rotation = t.rotation;
+		entry.scale = t.scale;
+
+		index.emplace(&t, uint32_t(transforms.size()));
+		transforms.emplace_back(entry);
+	}
+	names = std::make_shared< std::vector< char > const >(std::move(names_));
+
+	drawable_transforms.reserve(scene.drawables.size());
+	drawable_pipelines.reserve(scene.drawables.size());
+	drawable_bounds.reserve(scene.drawables.size());
+	drawable_occluders.reserve(scene.drawables.size());
+	drawable_dynamic.reserve(scene.drawables.size());
+	for (auto const &d : scene.drawables) {
+		drawable_transforms.emplace_back(index.at(d.transform));
+		drawable_pipelines.emplace_back(d.pipeline);
+		drawable_bounds.emplace_back(d.min, d.max);
+		drawable_occluders.emplace_back(d.occluder ? 1 : 0);
+		drawable_dynamic.emplace_back(d.dynamic ? 1 : 0);
+	}
+
+	cameras.reserve(scene.cameras.size());
+	for (auto const &c : scene.cameras) {
+		cameras.emplace_back(CameraEntry{ index.at(c.transform), c.fovy, c.aspect, c.near });
+	}
+
+	lights.reserve(scene.lights.size());
+	for (auto const &l : scene.lights) {
+		lights.emplace_back(LightEntry{ index.at(l.transform), l.type, l.energy, l.spot_fov });
+	}
+}
+
+void Scene::instantiate(Prefab const &prefab, Transform *parent, std::vector< Transform * > *transforms_) {
+	std::vector< Transform * > temp;
+	std::vector< Transform * > &created = *(transforms_ ? transforms_ : &temp);
+	created.clear();
+	created.reserve(prefab.transforms.size());
+
+	std::vector< NamedTransform > named;
+	named.reserve(prefab.transforms.size());
+
+	for (auto const &entry : prefab.transforms) {
+		transforms.emplace_back();
+		Transform &t = transforms.back();
+		std::string_view name(prefab.names->data() + entry.name_begin, entry.name_end - entry.name_begin);
+		t.name = name;
+		named.emplace_back(NamedTransform{ name, &t });
+		t.position = entry.position;
+		t.rotation = entry.rotation;
+		t.scale = entry.scale;
+		//parents always come first, so they have already been created:
+		t.parent = (entry.parent == -1U ? parent : created[entry.parent]);
+		created.emplace_back(&t);
+	}
+	if (!named.empty()) add_to_name_index(prefab.names, std::move(named));
+
+	for (uint32_t i = 0; i < prefab.drawable_transforms.size(); ++i) {
+		drawables.emplace_back(created[prefab.drawable_transforms[i]]);
+		drawables.back().pipeline = prefab.drawable_pipelines[i];
+		drawables.back().min = prefab.drawable_bounds[i].first;
+		drawables.back().max = prefab.drawable_bounds[i].second;
+		drawables.back().occluder = (prefab.drawable_occluders[i] != 0);
+		drawables.back().dynamic = (prefab.drawable_dynamic[i] != 0);
+	}
+
+	for (auto const &entry : prefab.cameras) {
+		cameras.emplace_back(created[entry.transform]);
+		Camera &c = cameras.back();
+		c.fovy = entry.fovy;
+		c.aspect = entry.aspect;
+		c.near = entry.near;
+	}
+
+	for (auto const &entry : prefab.lights) {
+		lights.emplace_back(created[entry.transform]);
+		Light &l = lights.back();
+		l.type = entry.type;
+		l.energy = entry.energy;
+		l.spot_fov = entry.spot_fov;
+	}
+}
+
+//-------------------------
+
+Scene::Transform *Scene::find(std::string_view name) const {
+	auto f = std::lower_bound(name_index.begin(), name_index.end(), name, [](NamedTransform const &a, std::string_view b){
+		return a.name < b;
+	});
+	if (f != name_index.end() && f->name == name) return f->transform;
+	return nullptr;
+}
+
+std::pair< Scene::NamedTransform const *, Scene::NamedTransform const * > Scene::find_prefix(std::string_view prefix) const {
+	auto begin = std::lower_bound(name_index.begin(), name_index.end(), prefix, [](NamedTransform const &a, std::string_view b){
+		return a.name < b;
+	});
+	//names starting with 'prefix' are contiguous and sort at or after 'prefix':
+	auto end = std::partition_point(begin, name_index.end(), [&prefix](NamedTransform const &a){
+		return a.name.substr(0, prefix.size()) == prefix;
+	});
+	return std::make_pair(name_index.data() + (begin - name_index.begin()), name_index.data() + (end - name_index.begin()));
+}
+
+void Scene::add_to_name_index(std::shared_ptr< std::vector< char > const > const &blob, std::vector< NamedTransform > &&entries) {
+	if (std::find(name_blobs.begin(), name_blobs.end(), blob) == name_blobs.end()) {
+		name_blobs.emplace_back(blob);
+	}
+
+	auto by_name = [](NamedTransform const &a, NamedTransform const &b){ return a.name < b.name; };
+	std::stable_sort(entries.begin(), entries.end(), by_name);
+
+	size_t old_size = name_index.size();
+	name_index.insert(name_index.end(), entries.begin(), entries.end());
+	std::inplace_merge(name_index.begin(), name_index.begin() + old_size, name_index.end(), by_name);
+}
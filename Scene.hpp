@@ -11,14 +11,17 @@
  */
 
 #include "GL.hpp"
+#include "OcclusionBuffer.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include <list>
+#include <limits>
 #include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -54,6 +57,17 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//object-space bounding box, used for frustum culling:
+		// (the default, min > max, means "unknown" -- such drawables are never culled)
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+		//is the bounding box solid (see Mesh::occluder)? if so, it may be used to occlusion-cull other drawables:
+		bool occluder = false;
+
+		//does it move during play (e.g., projectiles)? if not, depth-only views (like shadow maps) may cache it (see Scene::draw_depth):
+		bool dynamic = false;
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -65,11 +79,28 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//(optional) simplified versions of [start, start+count), coarser as index increases (see Mesh::lods);
+			// draw() switches to lods[i] once the drawable's projected bounding radius falls below lods[i].max_size:
+			struct Lod {
+				GLuint start = 0;
+				GLuint count = 0;
+				float max_size = 0.0f; //as a fraction of the viewport half-height
+			};
+			std::vector< Lod > lods;
+
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
 
+			//if set, the three matrices above are read from the program's 'Object' uniform block instead of from uniforms:
+			// (see "uniform blocks" below)
+			bool uses_object_block = false;
+
+			//(optional) depth-only program for Scene::depth_prepass; reads the 'Object' block (so only used along with uses_object_block),
+			// takes Position at the same attribute location as 'program', and must compute gl_Position identically (declare it 'invariant' in both):
+			GLuint depth_program = 0;
+
 			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
 
 			//texture objects to bind for the first TextureCount textures:
@@ -79,6 +110,10 @@ struct Scene {
 				GLenum target = GL_TEXTURE_2D;
 			} textures[TextureCount];
 		} pipeline;
+
+		//level of detail drawn most recently (0 => pipeline.start/count, i > 0 => pipeline.lods[i-1]);
+		// kept so that level changes can lag a bit (see Scene::lod_hysteresis):
+		mutable uint32_t lod = 0;
 	};
 
 	struct Camera {
@@ -128,6 +163,122 @@ struct Scene {
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//draw() runs in two stages:
+	// - prepare() computes matrices and frustum visibility for every drawable, then (if occlusion_culling is set)
+	//   culls drawables hidden behind the biggest on-screen occluders, and (if sort_front_to_back is set) orders the rest nearest-first;
+	//   it touches no OpenGL state and runs in parallel chunks on WorkerPool::shared().
+	// - submit() only issues OpenGL commands for the drawables prepare() found visible
+	//   (twice, if depth_prepass is set: once for depth, once for color).
+	struct ObjectMatrices {
+		glm::mat4 object_to_clip;
+		glm::mat4x3 object_to_light;
+		glm::mat3 normal_to_light;
+	};
+	//which drawables a view includes:
+	enum Filter : uint8_t {
+		AllDrawables,
+		StaticDrawables, //only drawables without the 'dynamic' flag
+		DynamicDrawables, //only drawables with the 'dynamic' flag
+	};
+	struct Prepared {
+		//set before prepare() for a depth-only view (e.g., a shadow map) of some of the drawables:
+		// such views leave Drawable::lod and draw_stats alone, and submit() draws only depth (with pipeline.depth_program, where set)
+		bool depth_only = false;
+		Filter filter = AllDrawables;
+
+		glm::mat4 world_to_clip = glm::mat4(1.0f);
+		glm::mat4x3 world_to_light = glm::mat4x3(1.0f);
+		std::vector< Drawable const * > drawables; //drawables that can be drawn (have a program, vao, and vertices)
+		std::vector< ObjectMatrices > matrices; //per entry in drawables
+		std::vector< uint8_t > visible; //per entry in drawables; 1 if inside the view frustum (and not occluded)
+		std::vector< float > sizes; //per entry in drawables; projected bounding radius as a fraction of viewport half-height (0 if not visible)
+		std::vector< float > depths; //per entry in drawables; view depth (clip w) of bounding box center
+		std::vector< uint32_t > lods; //per entry in drawables; level of detail to draw (as Drawable::lod)
+		std::vector< uint32_t > draw_list; //indices into drawables to submit, in order (nearest first if sort_front_to_back is set)
+		OcclusionBuffer occlusion; //occluders rasterized for this view
+		uint32_t occluders = 0; //occluders rasterized
+		uint32_t occluded = 0; //drawables in the view frustum but hidden by occluders
+	};
+	void prepare(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light, Prepared *prepared) const;
+	void submit(Prepared const &prepared) const;
+
+	//timings and counts from the most recent draw():
+	struct DrawStats {
+		uint32_t drawables = 0; //drawables considered
+		uint32_t visible = 0; //drawables that passed culling (i.e., were submitted)
+		uint32_t occluders = 0; //drawables rasterized as occluders
+		uint32_t occluded = 0; //drawables in the view frustum culled as hidden behind occluders
+		uint32_t draw_calls = 0; //glDrawArrays + glMultiDrawArrays calls issued, over all passes (drawables sharing a transform and pipeline state are batched)
+		uint32_t vertices = 0; //vertices submitted (after level-of-detail selection)
+		uint32_t full_vertices = 0; //vertices that would have been submitted without level-of-detail selection
+		uint32_t shaded_samples = 0; //samples that passed the depth test in the shading pass (if measure_overdraw; lags a few frames)
+		float overdraw = 0.0f; //shaded_samples per viewport pixel (1.0 => every covered pixel shaded once)
+		float prepare_ms = 0.0f; //wall-clock time in prepare()
+		float submit_ms = 0.0f; //CPU time spent issuing OpenGL commands in submit()
+	};
+	mutable DrawStats draw_stats;
+
+	//views reused by draw() and draw_depth(), so their allocations persist from frame to frame:
+	// (these point into this scene's drawables, so set() leaves them alone; prepare() rebuilds them each call anyway)
+	mutable Prepared draw_prepared;
+	mutable Prepared depth_prepared;
+
+	//scratch space for submit() (packed uniform blocks and per-batch vertex ranges), also kept between frames:
+	mutable std::vector< char > submit_blocks;
+	mutable std::vector< GLint > submit_batch_firsts;
+	mutable std::vector< GLsizei > submit_batch_counts;
+
+	//Depth-only drawing (e.g., into a shadow map): prepare() + submit() for a depth_only view of the drawables in 'filter';
+	// returns the number of drawables submitted:
+	uint32_t draw_depth(glm::mat4 const &world_to_clip, Filter filter = AllDrawables) const;
+
+	//a drawable moves to a coarser level of detail once its projected size is (1 - lod_hysteresis) times
+	// the level's max_size, and back to a finer level once it's (1 + lod_hysteresis) times the max_size:
+	float lod_hysteresis = 0.15f;
+
+	//occlusion culling: prepare() rasterizes up to max_occluders visible drawables marked 'occluder'
+	// (biggest on screen first) into a small CPU depth buffer, and culls drawables whose bounds are hidden behind them:
+	bool occlusion_culling = true;
+	uint32_t max_occluders = 32;
+
+	//opaque drawing order and overdraw:
+	bool sort_front_to_back = true; //prepare() sorts draw_list nearest-first, so early depth testing rejects hidden fragments
+	bool depth_prepass = false; //submit() draws depth only (with pipeline.depth_program, where set), then shades with GL_EQUAL so each pixel is shaded once
+	bool measure_overdraw = false; //count shaded samples with GL_SAMPLES_PASSED queries (see DrawStats::overdraw)
+
+	//Name index:
+	// Transforms created by load(), instantiate(), and set() are indexed by name.
+	// Lookups don't allocate: the index holds string views into shared name blobs
+	//  (e.g., a copy of the scene file's 'str0' chunk), sorted by name.
+	// Transforms added by hand are not indexed, and renaming a transform does not update the index.
+	struct NamedTransform {
+		std::string_view name;
+		Transform *transform;
+	};
+	std::vector< NamedTransform > name_index; //sorted by name
+	std::vector< std::shared_ptr< std::vector< char > const > > name_blobs; //storage for the views in name_index
+
+	//first transform named exactly 'name' (or nullptr if there are none):
+	Transform *find(std::string_view name) const;
+	//all indexed transforms whose names start with 'prefix', as a [begin, end) range of name_index:
+	std::pair< NamedTransform const *, NamedTransform const * > find_prefix(std::string_view prefix) const;
+
+	//add entries (with names pointing into 'blob') to the index:
+	void add_to_name_index(std::shared_ptr< std::vector< char > const > const &blob, std::vector< NamedTransform > &&entries);
+
+	//Uniform blocks:
+	// Programs may read per-frame and per-object matrices from std140 uniform blocks:
+	//   layout(std140) uniform Frame { mat4 WORLD_TO_CLIP; mat4x3 WORLD_TO_LIGHT; };
+	//   layout(std140) uniform Object { mat4 OBJECT_TO_CLIP; mat4x3 OBJECT_TO_LIGHT; mat3 NORMAL_TO_LIGHT; };
+	// For drawables with pipeline.uses_object_block set, draw() packs all of these matrices into
+	//  one (orphaned) uniform buffer per call and just binds a range of it for each draw.
+	//Call bind_uniform_blocks() once after linking such a program to attach its blocks to these binding points:
+	enum : GLuint {
+		FrameBlockBinding = 0,
+		ObjectBlockBinding = 1,
+	};
+	static void bind_uniform_blocks(GLuint program);
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
@@ -135,6 +286,77 @@ struct Scene {
 		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
 	);
 
+	//Loading is split into two stages so it can be spread across threads and frames:
+	// - FileData holds the parsed (and validated) contents of a scene file;
+	//   constructing one touches no Scene or OpenGL state, so it is safe on any thread.
+	// - instantiate() adds the parsed contents to this scene (main thread only),
+	//   optionally a few entries at a time.
+	struct FileData {
+		//read and validate a scene file; throws on file format errors:
+		FileData(std::string const &filename);
+
+		struct HierarchyEntry {
+			uint32_t parent;
+			uint32_t name_begin;
+			uint32_t name_end;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+		};
+		static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
+
+		struct MeshEntry {
+			uint32_t transform;
+			uint32_t name_begin;
+			uint32_t name_end;
+		};
+		static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
+
+		struct CameraEntry {
+			uint32_t transform;
+			char type[4]; //"pers" or "orth"
+			float data; //fov in degrees for 'pers', scale for 'orth'
+			float clip_near, clip_far;
+		};
+		static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
+
+		struct LightEntry {
+			uint32_t transform;
+			char type;
+			glm::u8vec3 color;
+			float energy;
+			float distance;
+			float fov;
+		};
+		static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
+
+		std::string filename;
+		std::vector< char > names;
+		std::vector< HierarchyEntry > hierarchy;
+		std::vector< MeshEntry > meshes;
+		std::vector< CameraEntry > cameras;
+		std::vector< LightEntry > lights;
+		std::vector< char > extra; //any bytes after the main chunks (handed to load_extra)
+
+		//number of steps instantiate() takes to add everything:
+		uint32_t entry_count() const { return uint32_t(hierarchy.size() + meshes.size() + cameras.size() + lights.size()); }
+	};
+
+	//progress through instantiating a FileData:
+	struct Instantiation {
+		std::vector< Transform * > transforms; //transforms created so far, in file order
+		std::shared_ptr< std::vector< char > const > names; //copy of the file's names, shared with the name index
+		uint32_t next = 0; //next entry to add (hierarchy, then meshes, cameras, lights)
+		bool done = false;
+	};
+
+	//add at most 'max_entries' more entries from 'data' to this scene; returns true once everything is added:
+	// (load_extra() is called on the final step)
+	bool instantiate(FileData const &data, Instantiation *progress,
+		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr,
+		uint32_t max_entries = -1U
+	);
+
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
 	// this is useful if you, e.g., subclassing scene to represent a game level/area
 	virtual void load_extra(std::istream &from, std::vector< char > const &str0, std::vector< Transform * > const &xfh0) { }
@@ -150,4 +372,57 @@ struct Scene {
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+
+	//Transform snapshots, e.g. for drawing one frame while the next is being simulated:
+	// (only local position/rotation/scale are captured; hierarchy is assumed unchanged)
+	struct TransformState {
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	void save_transform_state(std::vector< TransformState > *state) const;
+	//returns false (changing nothing) if 'state' has a different number of transforms than this scene:
+	bool load_transform_state(std::vector< TransformState > const &state);
+
+	//A Prefab is a flattened copy of a scene in which all references are indices:
+	// - copying a Prefab is a handful of vector copies (no pointer fixup)
+	// - instantiate() adds a copy of it to a scene, remapping parents through a plain array
+	// This makes it cheap to reset a level or to spawn many copies of the same thing.
+	struct Prefab {
+		Prefab() = default;
+		//flatten a scene (transforms must appear after their parents in scene.transforms, as they do after load):
+		Prefab(Scene const &scene);
+
+		struct TransformEntry {
+			uint32_t parent; //index into transforms, or -1U for none
+			uint32_t name_begin, name_end; //range in 'names'
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+		};
+		struct CameraEntry {
+			uint32_t transform;
+			float fovy, aspect, near;
+		};
+		struct LightEntry {
+			uint32_t transform;
+			Light::Type type;
+			glm::vec3 energy;
+			float spot_fov;
+		};
+
+		std::shared_ptr< std::vector< char > const > names; //all transform names, back-to-back (shared with instances' name indices)
+		std::vector< TransformEntry > transforms;
+		std::vector< uint32_t > drawable_transforms; //drawable i is attached to transforms[drawable_transforms[i]]...
+		std::vector< Drawable::Pipeline > drawable_pipelines; //...draws with drawable_pipelines[i]...
+		std::vector< std::pair< glm::vec3, glm::vec3 > > drawable_bounds; //...and has (min, max) bounds drawable_bounds[i]...
+		std::vector< uint8_t > drawable_occluders; //...which are solid if drawable_occluders[i] is 1...
+		std::vector< uint8_t > drawable_dynamic; //...and move during play if drawable_dynamic[i] is 1
+		std::vector< CameraEntry > cameras;
+		std::vector< LightEntry > lights;
+	};
+
+	//add a copy of 'prefab' to this scene, with its root transforms parented to 'parent':
+	// (if 'transforms' is given, it is filled with the created transforms, in prefab order)
+	void instantiate(Prefab const &prefab, Transform *parent = nullptr, std::vector< Transform * > *transforms = nullptr);
 };
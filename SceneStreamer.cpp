@@ -0,0 +1,95 @@
+#include "SceneStreamer.hpp"
+
+#include "WorkerPool.hpp"
+
+#include <unordered_set>
+#include <algorithm>
+#include <iostream>
+
+SceneStreamer::SceneStreamer(Scene &scene_, std::function< void(Scene &, Scene::Transform *, std::string const &) > const &on_drawable_) : scene(scene_), on_drawable(on_drawable_) {
+}
+
+void SceneStreamer::request(std::string const &region_name, std::string const &filename) {
+	if (regions.count(region_name)) return;
+
+	Region &region = regions[region_name];
+	region.filename = filename;
+	region.state = Parsing;
+	region.generation = next_generation++;
+
+	WorkerPool::shared().run([inbox = inbox, region_name, filename, generation = region.generation](){
+		Parsed parsed;
+		parsed.region = region_name;
+		parsed.generation = generation;
+		try {
+			parsed.data = std::make_unique< Scene::FileData >(filename);
+		} catch (std::exception &e) {
+			std::cerr << "Failed to load region '" << region_name << "' from '" << filename << "': " << e.what() << std::endl;
+		}
+		std::unique_lock< std::mutex > lock(inbox->mutex);
+		inbox->parsed.emplace_back(std::move(parsed));
+	});
+}
+
+void SceneStreamer::unload(std::string const &region_name) {
+	auto f = regions.find(region_name);
+	if (f == regions.end()) return;
+
+	//anything already merged into the scene gets removed:
+	std::unordered_set< Scene::Transform const * > doomed(f->second.progress.transforms.begin(), f->second.progress.transforms.end());
+	std::shared_ptr< std::vector< char > const > names = f->second.progress.names;
+	regions.erase(f);
+	if (doomed.empty()) return;
+
+	//drop index entries (and the name blob they point into):
+	scene.name_index.erase(std::remove_if(scene.name_index.begin(), scene.name_index.end(), [&](Scene::NamedTransform const &n){
+		return doomed.count(n.transform) != 0;
+	}), scene.name_index.end());
+	scene.name_blobs.erase(std::remove(scene.name_blobs.begin(), scene.name_blobs.end(), names), scene.name_blobs.end());
+
+	scene.drawables.remove_if([&](Scene::Drawable const &d){ return doomed.count(d.transform) != 0; });
+	scene.cameras.remove_if([&](Scene::Camera const &c){ return doomed.count(c.transform) != 0; });
+	scene.lights.remove_if([&](Scene::Light const &l){ return doomed.count(l.transform) != 0; });
+	scene.transforms.remove_if([&](Scene::Transform const &t){ return doomed.count(&t) != 0; });
+}
+
+void SceneStreamer::update(uint32_t max_entries) {
+	{ //pick up finished parses (dropping any for regions unloaded in the meantime):
+		std::unique_lock< std::mutex > lock(inbox->mutex);
+		while (!inbox->parsed.empty()) {
+			Parsed parsed = std::move(inbox->parsed.front());
+			inbox->parsed.pop_front();
+
+			auto f = regions.find(parsed.region);
+			if (f == regions.end() || f->second.generation != parsed.generation) continue;
+			Region &region = f->second;
+			if (parsed.data) {
+				region.data = std::move(parsed.data);
+				region.state = Merging;
+			} else {
+				region.state = Failed;
+			}
+		}
+	}
+
+	//merge, within budget:
+	for (auto &[name, region] : regions) {
+		if (max_entries == 0) break;
+		if (region.state != Merging) continue;
+
+		uint32_t before = region.progress.next;
+		bool done = scene.instantiate(*region.data, &region.progress, on_drawable, max_entries);
+		max_entries -= std::min(max_entries, region.progress.next - before);
+
+		if (done) {
+			region.state = Resident;
+			region.data.reset(); //parsed data is no longer needed
+		}
+	}
+}
+
+SceneStreamer::State SceneStreamer::state(std::string const &region_name) const {
+	auto f = regions.find(region_name);
+	if (f == regions.end()) return Missing;
+	return f->second.state;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ * SceneStreamer loads scene files ("regions") into a live Scene in the background:
+ *  - request() parses the file on WorkerPool::shared()
+ *  - update() merges parsed regions into the scene a bounded number of entries at a time
+ *  - unload() removes a region's transforms (and attached drawables, cameras, and lights)
+ *
+ * Regions are independent: transforms outside a region should not be parented to
+ * transforms inside it, since those get deleted when the region unloads.
+ */
+
+#include "Scene.hpp"
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+
+struct SceneStreamer {
+	//regions will be merged into 'scene'; 'on_drawable' is called (on the main thread) as for Scene::load:
+	SceneStreamer(Scene &scene, std::function< void(Scene &, Scene::Transform *, std::string const &) > const &on_drawable);
+
+	SceneStreamer(SceneStreamer const &) = delete;
+	SceneStreamer &operator=(SceneStreamer const &) = delete;
+
+	//start loading 'filename' as region 'region' (no effect if the region is already requested):
+	void request(std::string const &region, std::string const &filename);
+
+	//remove a region (cancels it if still loading):
+	void unload(std::string const &region);
+
+	//merge parsed regions into the scene, adding at most 'max_entries' entries in total; main thread only:
+	void update(uint32_t max_entries = 256);
+
+	enum State {
+		Missing, //never requested (or unloaded)
+		Parsing, //being read on a worker
+		Merging, //being added to the scene by update()
+		Resident, //fully present in the scene
+		Failed, //file could not be read (error already printed)
+	};
+	State state(std::string const &region) const;
+
+	//------ internals ------
+	Scene &scene;
+	std::function< void(Scene &, Scene::Transform *, std::string const &) > on_drawable;
+
+	struct Region {
+		std::string filename;
+		State state = Parsing;
+		uint32_t generation = 0; //distinguishes this request from earlier (unloaded) requests of the same region
+		std::unique_ptr< Scene::FileData > data;
+		Scene::Instantiation progress;
+	};
+	std::map< std::string, Region > regions;
+	uint32_t next_generation = 1;
+
+	//results from workers; shared so jobs finishing after the streamer is destroyed remain safe:
+	struct Parsed {
+		std::string region;
+		uint32_t generation;
+		std::unique_ptr< Scene::FileData > data; //null if the file failed to load
+	};
+	struct Inbox {
+		std::mutex mutex;
+		std::deque< Parsed > parsed;
+	};
+	std::shared_ptr< Inbox > inbox = std::make_shared< Inbox >();
+};
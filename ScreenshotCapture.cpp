@@ -0,0 +1,161 @@
+#include "ScreenshotCapture.hpp"
+
+#include "WorkerPool.hpp"
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+
+ScreenshotCapture::~ScreenshotCapture() {
+	if (!pending.empty() || !spare_buffers.empty()) {
+		std::cerr << "WARNING: ScreenshotCapture destroyed without finish(); some captures were lost." << std::endl;
+	}
+}
+
+void ScreenshotCapture::capture(glm::uvec2 const &size, std::string const &filename) {
+	if (size.x == 0 || size.y == 0) return;
+
+	//too many readbacks outstanding? retire the oldest now (may wait on the GPU):
+	if (pending.size() >= MaxPending) {
+		retire(pending[0]);
+		pending.erase(pending.begin());
+	}
+
+	size_t bytes = size_t(size.x) * size_t(size.y) * 4;
+
+	Readback readback;
+	readback.size = size;
+	readback.filename = filename;
+
+	//re-use a spare buffer if there is one:
+	size_t allocated = 0;
+	if (!spare_buffers.empty()) {
+		readback.buffer = spare_buffers.back().first;
+		allocated = spare_buffers.back().second;
+		spare_buffers.pop_back();
+	} else {
+		glGenBuffers(1, &readback.buffer);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	if (allocated != bytes) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	//with a pack buffer bound, the last argument is an offset and the read does not block:
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid *)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	GL_ERRORS();
+
+	pending.emplace_back(readback);
+}
+
+void ScreenshotCapture::poll(glm::uvec2 const &size) {
+	if (recording()) {
+		//drop frames rather than queue unbounded memory when encoding can't keep up:
+		if (encoding->load() + pending.size() >= MaxEncoding) {
+			sequence_skipped += 1;
+		} else {
+			char number[16];
+			snprintf(number, 16, "%05u", sequence_frame);
+			capture(size, sequence_prefix + "-" + number + ".png");
+		}
+		sequence_frame += 1;
+	}
+
+	//retire, in order, readbacks that the GPU has finished:
+	uint32_t done = 0;
+	while (done < pending.size()) {
+		GLenum status = glClientWaitSync(pending[done].fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		retire(pending[done]);
+		done += 1;
+	}
+	pending.erase(pending.begin(), pending.begin() + done);
+}
+
+void ScreenshotCapture::retire(Readback &readback) {
+	//wait for the readback (immediate if poll() already saw the fence pass):
+	while (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+	}
+	glDeleteSync(readback.fence);
+	readback.fence = 0;
+
+	size_t bytes = size_t(readback.size.x) * size_t(readback.size.y) * 4;
+
+	auto data = std::make_shared< std::vector< glm::u8vec4 > >(readback.size.x * readback.size.y);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	void const *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+	if (mapped) {
+		std::memcpy(data->data(), mapped, bytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	} else {
+		std::cerr << "WARNING: failed to map screenshot buffer; '" << readback.filename << "' not saved." << std::endl;
+		data.reset();
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	spare_buffers.emplace_back(readback.buffer, bytes);
+	readback.buffer = 0;
+
+	GL_ERRORS();
+
+	if (!data) return;
+
+	//alpha fix-up and encode happen off the main thread:
+	auto encoding_ = encoding;
+	encoding_->fetch_add(1);
+	WorkerPool::shared().run([data, size = readback.size, filename = readback.filename, encoding_](){
+		for (auto &px : *data) {
+			px.a = 0xff;
+		}
+		try {
+			save_png(filename, size, data->data(), LowerLeftOrigin);
+		} catch (std::exception &e) {
+			std::cerr << "Failed to save screenshot '" << filename << "': " << e.what() << std::endl;
+		}
+		encoding_->fetch_sub(1);
+	});
+}
+
+void ScreenshotCapture::finish() {
+	stop_sequence();
+	for (auto &readback : pending) {
+		retire(readback);
+	}
+	pending.clear();
+
+	for (auto const &spare : spare_buffers) {
+		glDeleteBuffers(1, &spare.first);
+	}
+	spare_buffers.clear();
+
+	while (encoding->load() != 0) {
+		std::this_thread::yield();
+	}
+}
+
+void ScreenshotCapture::start_sequence(std::string const &prefix) {
+	sequence_prefix = prefix;
+	sequence_frame = 0;
+	sequence_skipped = 0;
+	std::cout << "Recording frames to '" << sequence_prefix << "-NNNNN.png'." << std::endl;
+}
+
+void ScreenshotCapture::stop_sequence() {
+	if (!recording()) return;
+	std::cout << "Stopped recording after " << sequence_frame << " frames";
+	if (sequence_skipped) std::cout << " (" << sequence_skipped << " dropped because encoding fell behind)";
+	std::cout << "." << std::endl;
+	sequence_prefix.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * ScreenshotCapture reads back frames without stalling the main loop:
+ *  - capture() starts an asynchronous glReadPixels into a pixel buffer object and fences it
+ *  - poll() maps readbacks whose fence has passed (usually a frame or two later)
+ *    and hands the pixels to WorkerPool::shared() for the alpha fix-up and PNG encode
+ *
+ * Call finish() before destroying the OpenGL context.
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+
+struct ScreenshotCapture {
+	ScreenshotCapture() = default;
+	~ScreenshotCapture();
+
+	ScreenshotCapture(ScreenshotCapture const &) = delete;
+	ScreenshotCapture &operator=(ScreenshotCapture const &) = delete;
+
+	//start reading back the default framebuffer's back buffer (call after drawing, before swap):
+	void capture(glm::uvec2 const &size, std::string const &filename);
+
+	//call once per frame after drawing, before swap; captures a sequence frame if recording, then retires completed readbacks:
+	void poll(glm::uvec2 const &size);
+
+	//block until all readbacks are mapped and all encodes have finished; frees GL objects:
+	void finish();
+
+	//frame-sequence capture: while non-empty, every frame is saved as 'sequence_prefix-NNNNN.png':
+	void start_sequence(std::string const &prefix);
+	void stop_sequence();
+	bool recording() const { return !sequence_prefix.empty(); }
+
+	std::string sequence_prefix;
+	uint32_t sequence_frame = 0;
+	uint32_t sequence_skipped = 0; //frames dropped because encoding fell behind
+
+	//readbacks in flight, oldest first:
+	struct Readback {
+		GLuint buffer = 0;
+		GLsync fence = 0;
+		glm::uvec2 size = glm::uvec2(0);
+		std::string filename;
+	};
+	std::vector< Readback > pending;
+	std::vector< std::pair< GLuint, size_t > > spare_buffers; //(buffer, allocated bytes)
+
+	//number of encodes queued or running on workers (shared so jobs can outlive this object):
+	std::shared_ptr< std::atomic< uint32_t > > encoding = std::make_shared< std::atomic< uint32_t > >(0);
+
+	//limits on work in flight:
+	static constexpr uint32_t MaxPending = 3;
+	static constexpr uint32_t MaxEncoding = 8;
+
+	//internals:
+	void retire(Readback &readback); //map (waiting if needed), queue encode, recycle buffer
+};
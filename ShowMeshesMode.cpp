@@ -101,6 +101,12 @@ bool ShowMeshesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window
 	return false;
 }
 
+void ShowMeshesMode::set_benchmark_view(float t) {
+	//one full orbit around the target:
+	camera.azimuth = (2.0f * t - 1.0f) * 3.1415926f;
+	camera.flip_x = false;
+}
+
 void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 	//--- use camera structure to set up scene camera ---
 
@@ -152,11 +158,13 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 }
 
 void ShowMeshesMode::select_prev_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) --f;
-	if (f == buffer.meshes.end()) f = buffer.meshes.begin();
+	//(buffer.meshes is sorted by name, so neighbors in the list are neighbors by name)
+	uint32_t i = buffer.find(current_mesh_name);
+	if (i != -1U && i > 0) --i;
+	if (i == -1U) i = 0;
 
-	if (f != buffer.meshes.end()) {
+	if (i < buffer.meshes.size()) {
+		auto const *f = &buffer.meshes[i];
 		current_mesh_name = f->first;
 		scene_drawable->pipeline.type = f->second.type;
 		scene_drawable->pipeline.start = f->second.start;
@@ -174,18 +182,14 @@ void ShowMeshesMode::select_prev_mesh() {
 }
 
 void ShowMeshesMode::select_next_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) ++f;
-	if (f == buffer.meshes.end()) {
-		auto temp = buffer.meshes.rbegin();
-		if (temp != buffer.meshes.rend()) {
-			++temp;
-			f = temp.base();
-			assert(f != buffer.meshes.end());
-		}
+	uint32_t i = buffer.find(current_mesh_name);
+	if (i != -1U) ++i;
+	if (i == -1U || i >= buffer.meshes.size()) {
+		i = uint32_t(buffer.meshes.size()) - 1; //(== -1U if there are no meshes)
 	}
 
-	if (f != buffer.meshes.end()) {
+	if (i < buffer.meshes.size()) {
+		auto const *f = &buffer.meshes[i];
 		current_mesh_name = f->first;
 		scene_drawable->pipeline.type = f->second.type;
 		scene_drawable->pipeline.start = f->second.start;
@@ -17,6 +17,8 @@ struct ShowMeshesMode : Mode {
 
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
+	virtual void set_benchmark_view(float t) override;
+	virtual Scene *drawn_scene() override { return &scene; }
 
 	//z-up trackball-style camera controls:
 	struct {
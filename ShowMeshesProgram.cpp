@@ -1,5 +1,6 @@
 #include "ShowMeshesProgram.hpp"
 
+#include "GeometryPool.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -88,6 +89,7 @@ ShowMeshesProgram::ShowMeshesProgram() {
 }
 
 ShowMeshesProgram::~ShowMeshesProgram() {
+	GeometryPool::forget_program(program);
 	glDeleteProgram(program);
 	program = 0;
 }
@@ -3,7 +3,7 @@
 
 #include <iostream>
 
-ShowSceneMode::ShowSceneMode(Scene const &scene_) : scene(scene_) {
+ShowSceneMode::ShowSceneMode(Scene &scene_, SceneStreamer *streamer_) : scene(scene_), streamer(streamer_) {
 
 	//Set up camera-only scene:
 	{ //create a single camera:
@@ -72,6 +72,16 @@ bool ShowSceneMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_
 	return false;
 }
 
+void ShowSceneMode::update(float elapsed) {
+	if (streamer) streamer->update(stream_entries_per_frame);
+}
+
+void ShowSceneMode::set_benchmark_view(float t) {
+	//one full orbit around the target:
+	camera.azimuth = (2.0f * t - 1.0f) * 3.1415926f;
+	camera.flip_x = false;
+}
+
 void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 	//--- use camera structure to set up scene camera ---
 
@@ -10,13 +10,18 @@
 #include "Mode.hpp"
 #include "Scene.hpp"
 #include "Mesh.hpp"
+#include "SceneStreamer.hpp"
 
 struct ShowSceneMode : Mode {
-	ShowSceneMode(Scene const &scene);
+	//if 'streamer' is given, the scene fills in as it merges regions (a bounded number of entries per update):
+	ShowSceneMode(Scene &scene, SceneStreamer *streamer = nullptr);
 	virtual ~ShowSceneMode();
 
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
+	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
+	virtual void set_benchmark_view(float t) override;
+	virtual Scene *drawn_scene() override { return &scene; }
 
 	//z-up trackball-style camera controls:
 	struct {
@@ -28,7 +33,11 @@ struct ShowSceneMode : Mode {
 	} camera;
 
 	//Scene being viewed:
-	Scene const &scene;
+	Scene &scene;
+
+	//(optional) streamer filling in the scene:
+	SceneStreamer *streamer = nullptr;
+	uint32_t stream_entries_per_frame = 256;
 
 	//mode uses a secondary Scene to hold a camera:
 	Scene camera_scene;
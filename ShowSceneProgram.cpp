@@ -1,5 +1,6 @@
 #include "ShowSceneProgram.hpp"
 
+#include "GeometryPool.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -88,6 +89,7 @@ ShowSceneProgram::ShowSceneProgram() {
 }
 
 ShowSceneProgram::~ShowSceneProgram() {
+	GeometryPool::forget_program(program);
 	glDeleteProgram(program);
 	program = 0;
 }
@@ -0,0 +1,150 @@
+#include "TextureLoader.hpp"
+
+#include "WorkerPool.hpp"
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+//box-filter 'src' (of size 'size') down to the next mip level:
+static void downsample(glm::uvec2 const &size, std::vector< glm::u8vec4 > const &src, glm::uvec2 *out_size, std::vector< glm::u8vec4 > *out) {
+	glm::uvec2 half = glm::max(glm::uvec2(1), size / 2U);
+	out->resize(half.x * half.y);
+	for (uint32_t y = 0; y < half.y; ++y) {
+		uint32_t y0 = std::min(size.y - 1, 2 * y);
+		uint32_t y1 = std::min(size.y - 1, 2 * y + 1);
+		for (uint32_t x = 0; x < half.x; ++x) {
+			uint32_t x0 = std::min(size.x - 1, 2 * x);
+			uint32_t x1 = std::min(size.x - 1, 2 * x + 1);
+			glm::uvec4 sum = glm::uvec4(src[y0 * size.x + x0]) + glm::uvec4(src[y0 * size.x + x1])
+			               + glm::uvec4(src[y1 * size.x + x0]) + glm::uvec4(src[y1 * size.x + x1]);
+			(*out)[y * half.x + x] = glm::u8vec4((sum + glm::uvec4(2)) / 4U);
+		}
+	}
+	*out_size = half;
+}
+
+TextureLoader::Texture const *TextureLoader::load(std::string const &filename, bool mipmaps) {
+	textures.emplace_back(std::make_unique< Texture >());
+	Texture *texture = textures.back().get();
+	texture->filename = filename;
+
+	//placeholder contents so the texture is usable immediately:
+	glGenTextures(1, &texture->texture);
+	glBindTexture(GL_TEXTURE_2D, texture->texture);
+	glm::u8vec4 white(0xff);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	GL_ERRORS();
+
+	outstanding_count += 1;
+
+	WorkerPool::shared().run([this, texture, filename, mipmaps](){
+		auto result = std::make_unique< Decoded >();
+		result->texture = texture;
+		try {
+			result->sizes.emplace_back();
+			result->levels.emplace_back();
+			load_png(filename, &result->sizes[0], &result->levels[0], LowerLeftOrigin);
+			while (mipmaps && (result->sizes.back().x > 1 || result->sizes.back().y > 1)) {
+				glm::uvec2 size;
+				std::vector< glm::u8vec4 > level;
+				downsample(result->sizes.back(), result->levels.back(), &size, &level);
+				result->sizes.emplace_back(size);
+				result->levels.emplace_back(std::move(level));
+			}
+		} catch (std::exception &e) {
+			std::cerr << "Failed to load texture '" << filename << "': " << e.what() << std::endl;
+			result->sizes.clear();
+			result->levels.clear();
+		}
+		std::unique_lock< std::mutex > lock(decoded_mutex);
+		decoded.emplace_back(std::move(result));
+	});
+
+	return texture;
+}
+
+void TextureLoader::update(float budget) {
+	{ //collect whatever the workers have finished:
+		std::unique_lock< std::mutex > lock(decoded_mutex);
+		while (!decoded.empty()) {
+			uploading.emplace_back(std::move(decoded.front()));
+			decoded.pop_front();
+		}
+	}
+	if (uploading.empty()) return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto spent = [&start]() {
+		return std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	if (upload_buffer == 0) glGenBuffers(1, &upload_buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_buffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	do {
+		Decoded &item = *uploading.front();
+		Texture &texture = *item.texture;
+
+		if (item.levels.empty()) {
+			texture.failed = true;
+		} else {
+			uint32_t level = uint32_t(item.levels.size()) - 1 - item.next;
+			glm::uvec2 size = item.sizes[level];
+			size_t bytes = item.levels[level].size() * sizeof(glm::u8vec4);
+
+			//orphan + refill, so the driver need not wait for the previous upload to finish reading:
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+			void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (mapped) {
+				std::memcpy(mapped, item.levels[level].data(), bytes);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			} else {
+				glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, bytes, item.levels[level].data());
+			}
+
+			glBindTexture(GL_TEXTURE_2D, texture.texture);
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid const *)0);
+			//only sample the levels that are present so far:
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(item.levels.size()) - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, GLint(level));
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			std::vector< glm::u8vec4 >().swap(item.levels[level]); //free memory as we go
+			item.next += 1;
+			if (item.next < item.levels.size()) continue;
+
+			texture.size = item.sizes[0];
+			texture.ready = true;
+		}
+
+		uploading.pop_front();
+		outstanding_count -= 1;
+	} while (!uploading.empty() && spent() < budget);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GL_ERRORS();
+}
+
+void TextureLoader::finish() {
+	while (outstanding_count > 0) {
+		update(1e9f);
+		if (outstanding_count > 0) std::this_thread::yield();
+	}
+}
+
+TextureLoader &TextureLoader::shared() {
+	static TextureLoader loader;
+	return loader;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+ * TextureLoader streams PNG textures in without hitching the frame:
+ *  - load() returns a texture name right away (holding a 1x1 white placeholder)
+ *  - the PNG is decoded (and, optionally, mipmapped) on WorkerPool::shared()
+ *  - update() uploads decoded levels through a pixel unpack buffer,
+ *    stopping once the per-frame time budget is spent
+ *
+ * Mip levels are uploaded smallest-first and GL_TEXTURE_BASE_LEVEL follows along,
+ * so a texture sharpens over a few frames instead of popping in all at once.
+ *
+ * Textures are never freed (like other Load<>-style resources).
+ */
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+struct TextureLoader {
+	struct Texture {
+		GLuint texture = 0;
+		std::string filename;
+		glm::uvec2 size = glm::uvec2(0); //size of level zero, once decoded
+		bool ready = false; //all levels uploaded
+		bool failed = false; //decode failed; placeholder stays bound
+	};
+
+	//queue 'filename' for loading; returned pointer stays valid forever:
+	Texture const *load(std::string const &filename, bool mipmaps = true);
+
+	//upload decoded data until 'budget' seconds have passed (always makes some progress); main thread only:
+	void update(float budget = 0.002f);
+
+	//upload everything, waiting on decodes as needed; main thread only:
+	void finish();
+
+	//textures still decoding or uploading:
+	uint32_t outstanding() const { return outstanding_count; }
+
+	static TextureLoader &shared();
+
+	//------ internals ------
+
+	//decoded (worker-side) result, waiting for upload:
+	struct Decoded {
+		Texture *texture = nullptr;
+		std::vector< glm::uvec2 > sizes; //per level, level zero first
+		std::vector< std::vector< glm::u8vec4 > > levels;
+		uint32_t next = 0; //levels are uploaded from last (smallest) to first; this counts uploaded levels
+	};
+
+	std::deque< std::unique_ptr< Texture > > textures;
+	uint32_t outstanding_count = 0;
+
+	std::mutex decoded_mutex;
+	std::deque< std::unique_ptr< Decoded > > decoded; //filled by workers
+
+	std::deque< std::unique_ptr< Decoded > > uploading; //main thread only
+	GLuint upload_buffer = 0;
+};
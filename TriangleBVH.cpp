@@ -0,0 +1,547 @@
+#include "TriangleBVH.hpp"
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRIANGLE_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+static constexpr float Infinity = std::numeric_limits< float >::infinity();
+
+//------------------------------------------------
+//building:
+
+//(half the) surface area of a box, for the SAH cost:
+static float area(glm::vec3 const &min, glm::vec3 const &max) {
+	glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+TriangleBVH::TriangleBVH(std::vector< glm::vec3 > const &vertices, std::vector< glm::uvec3 > const &triangles) {
+	if (triangles.empty()) return;
+
+	struct Item {
+		glm::vec3 min, max;
+		glm::vec3 centroid;
+		uint32_t triangle;
+	};
+	std::vector< Item > items(triangles.size());
+	for (uint32_t t = 0; t < triangles.size(); ++t) {
+		glm::vec3 const &a = vertices[triangles[t].x];
+		glm::vec3 const &b = vertices[triangles[t].y];
+		glm::vec3 const &c = vertices[triangles[t].z];
+		items[t].min = glm::min(a, glm::min(b, c));
+		items[t].max = glm::max(a, glm::max(b, c));
+		items[t].centroid = (a + b + c) / 3.0f;
+		items[t].triangle = t;
+	}
+
+	nodes.reserve(items.size() / 2 + 1);
+	leaves.reserve(items.size() / 2 + 1);
+
+	//build node for items [begin,end), returning its index:
+	struct Builder {
+		TriangleBVH &bvh;
+		std::vector< glm::vec3 > const &vertices;
+		std::vector< glm::uvec3 > const &triangles;
+		std::vector< Item > &items;
+
+		uint32_t build(uint32_t begin, uint32_t end, uint32_t depth) {
+			uint32_t index = uint32_t(bvh.nodes.size());
+			bvh.nodes.emplace_back();
+
+			glm::vec3 min = glm::vec3( Infinity);
+			glm::vec3 max = glm::vec3(-Infinity);
+			glm::vec3 centroid_min = glm::vec3( Infinity);
+			glm::vec3 centroid_max = glm::vec3(-Infinity);
+			for (uint32_t i = begin; i < end; ++i) {
+				min = glm::min(min, items[i].min);
+				max = glm::max(max, items[i].max);
+				centroid_min = glm::min(centroid_min, items[i].centroid);
+				centroid_max = glm::max(centroid_max, items[i].centroid);
+			}
+			bvh.nodes[index].min = min;
+			bvh.nodes[index].max = max;
+
+			if (end - begin <= 4) {
+				bvh.nodes[index].index = uint32_t(bvh.leaves.size());
+				bvh.nodes[index].count = end - begin;
+				bvh.leaves.emplace_back();
+				Leaf &leaf = bvh.leaves.back();
+				for (uint32_t lane = 0; lane < 4; ++lane) {
+					glm::vec3 a(0.0f), e1(0.0f), e2(0.0f);
+					uint32_t t = -1U;
+					if (begin + lane < end) {
+						t = items[begin + lane].triangle;
+						a = vertices[triangles[t].x];
+						e1 = vertices[triangles[t].y] - a;
+						e2 = vertices[triangles[t].z] - a;
+					}
+					leaf.ax[lane] = a.x; leaf.ay[lane] = a.y; leaf.az[lane] = a.z;
+					leaf.e1x[lane] = e1.x; leaf.e1y[lane] = e1.y; leaf.e1z[lane] = e1.z;
+					leaf.e2x[lane] = e2.x; leaf.e2y[lane] = e2.y; leaf.e2z[lane] = e2.z;
+					leaf.triangle[lane] = t;
+				}
+				return index;
+			}
+
+			//binned SAH: bin centroids along each axis, pick the cheapest bin boundary:
+			constexpr uint32_t Bins = 12;
+			uint32_t best_axis = 3;
+			uint32_t best_split = 0;
+			float best_cost = Infinity;
+			if (depth < 48) { //(past that, fall back to median splits so the tree depth stays bounded)
+				for (uint32_t axis = 0; axis < 3; ++axis) {
+					float extent = centroid_max[axis] - centroid_min[axis];
+					if (!(extent > 0.0f)) continue;
+					float scale = Bins / extent;
+
+					struct Bin {
+						glm::vec3 min = glm::vec3( Infinity);
+						glm::vec3 max = glm::vec3(-Infinity);
+						uint32_t count = 0;
+					} bins[Bins];
+					for (uint32_t i = begin; i < end; ++i) {
+						uint32_t b = std::min(Bins - 1, uint32_t((items[i].centroid[axis] - centroid_min[axis]) * scale));
+						bins[b].min = glm::min(bins[b].min, items[i].min);
+						bins[b].max = glm::max(bins[b].max, items[i].max);
+						bins[b].count += 1;
+					}
+
+					//cost of splitting after bin 's' is area(left) * count(left) + area(right) * count(right):
+					float right_cost[Bins];
+					glm::vec3 rmin = glm::vec3( Infinity);
+					glm::vec3 rmax = glm::vec3(-Infinity);
+					uint32_t rcount = 0;
+					for (uint32_t s = Bins - 1; s > 0; --s) {
+						rmin = glm::min(rmin, bins[s].min);
+						rmax = glm::max(rmax, bins[s].max);
+						rcount += bins[s].count;
+						right_cost[s] = (rcount ? area(rmin, rmax) * rcount : 0.0f);
+					}
+					glm::vec3 lmin = glm::vec3( Infinity);
+					glm::vec3 lmax = glm::vec3(-Infinity);
+					uint32_t lcount = 0;
+					for (uint32_t s = 1; s < Bins; ++s) {
+						lmin = glm::min(lmin, bins[s-1].min);
+						lmax = glm::max(lmax, bins[s-1].max);
+						lcount += bins[s-1].count;
+						if (lcount == 0 || lcount == end - begin) continue;
+						float cost = area(lmin, lmax) * lcount + right_cost[s];
+						if (cost < best_cost) {
+							best_cost = cost;
+							best_axis = axis;
+							best_split = s;
+						}
+					}
+				}
+			}
+
+			uint32_t mid;
+			if (best_axis < 3) {
+				float scale = Bins / (centroid_max[best_axis] - centroid_min[best_axis]);
+				auto first_right = std::partition(items.begin() + begin, items.begin() + end, [&](Item const &item){
+					return std::min(Bins - 1, uint32_t((item.centroid[best_axis] - centroid_min[best_axis]) * scale)) < best_split;
+				});
+				mid = uint32_t(first_right - items.begin());
+			} else {
+				//no useful split (e.g., coincident centroids): halve by count along the longest axis:
+				glm::vec3 extent = centroid_max - centroid_min;
+				uint32_t axis = (extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2));
+				mid = begin + (end - begin) / 2;
+				std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, [axis](Item const &a, Item const &b){
+					return a.centroid[axis] < b.centroid[axis];
+				});
+			}
+			assert(begin < mid && mid < end);
+
+			build(begin, mid, depth + 1); //first child is always the next node
+			uint32_t second = build(mid, end, depth + 1);
+			bvh.nodes[index].index = second;
+			bvh.nodes[index].count = 0;
+			return index;
+		}
+	};
+
+	Builder builder{*this, vertices, triangles, items};
+	builder.build(0, uint32_t(items.size()), 0);
+}
+
+//------------------------------------------------
+//traversal:
+
+//'enter' returns a sort key for a node (e.g., distance along a ray) or Infinity to skip it;
+// 'leaf' returns true to stop the traversal early:
+template< typename Enter, typename VisitLeaf >
+void TriangleBVH::traverse(Enter const &enter, VisitLeaf const &leaf) const {
+	if (nodes.empty()) return;
+
+	uint32_t stack[128]; //tree depth is bounded by the builder's median-split fallback
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t n = stack[--top];
+		if (enter(nodes[n]) == Infinity) continue; //(re-checked, since the query may have narrowed since this was pushed)
+
+		while (true) {
+			Node const &node = nodes[n];
+			if (node.count) {
+				if (leaf(leaves[node.index])) return;
+				break;
+			}
+			//visit the closer child first:
+			uint32_t a = n + 1, b = node.index;
+			float ka = enter(nodes[a]);
+			float kb = enter(nodes[b]);
+			if (kb < ka) {
+				std::swap(a, b);
+				std::swap(ka, kb);
+			}
+			if (ka == Infinity) break;
+			if (kb != Infinity) {
+				assert(top < 128);
+				stack[top++] = b;
+			}
+			n = a;
+		}
+	}
+}
+
+//entry distance of a ray into a box, or Infinity if it misses (or enters beyond max_t):
+struct RayBox {
+	RayBox(TriangleBVH::Ray const &ray) : origin(ray.origin) {
+		for (uint32_t i = 0; i < 3; ++i) {
+			//(nudge zero components so the slab math never sees 0 * inf):
+			float d = (ray.direction[i] == 0.0f ? 1e-30f : ray.direction[i]);
+			inv_direction[i] = 1.0f / d;
+		}
+	}
+	float enter(glm::vec3 const &min, glm::vec3 const &max, float max_t) const {
+		glm::vec3 t0 = (min - origin) * inv_direction;
+		glm::vec3 t1 = (max - origin) * inv_direction;
+		glm::vec3 near = glm::min(t0, t1);
+		glm::vec3 far = glm::max(t0, t1);
+		float t_enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+		float t_exit = std::min(std::min(far.x, far.y), std::min(far.z, max_t));
+		return (t_enter <= t_exit ? t_enter : Infinity);
+	}
+	glm::vec3 origin;
+	glm::vec3 inv_direction;
+};
+
+//Moller-Trumbore against all four triangles of a leaf; returns the lane of the closest hit before *t (updating *t, *u, *v), or -1:
+static int intersect_leaf(TriangleBVH::Leaf const &leaf, glm::vec3 const &o, glm::vec3 const &d, float *t_, float *u_, float *v_) {
+	float ts[4], us[4], vs[4];
+	int mask = 0;
+#ifdef TRIANGLE_BVH_SSE
+	__m128 const ox = _mm_set1_ps(o.x), oy = _mm_set1_ps(o.y), oz = _mm_set1_ps(o.z);
+	__m128 const dx = _mm_set1_ps(d.x), dy = _mm_set1_ps(d.y), dz = _mm_set1_ps(d.z);
+	__m128 const e1x = _mm_load_ps(leaf.e1x), e1y = _mm_load_ps(leaf.e1y), e1z = _mm_load_ps(leaf.e1z);
+	__m128 const e2x = _mm_load_ps(leaf.e2x), e2y = _mm_load_ps(leaf.e2y), e2z = _mm_load_ps(leaf.e2z);
+
+	//p = d x e2, det = e1 . p
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+	//s = o - a, u = (s . p) / det
+	__m128 sx = _mm_sub_ps(ox, _mm_load_ps(leaf.ax));
+	__m128 sy = _mm_sub_ps(oy, _mm_load_ps(leaf.ay));
+	__m128 sz = _mm_sub_ps(oz, _mm_load_ps(leaf.az));
+	__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inv_det);
+
+	//q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inv_det);
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inv_det);
+
+	//(degenerate/padding lanes have det == 0, so their u/v/t are inf or NaN and fail these compares)
+	__m128 const zero = _mm_setzero_ps();
+	__m128 hit = _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero));
+	hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+	hit = _mm_and_ps(hit, _mm_cmpge_ps(t, zero));
+	hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _mm_set1_ps(*t_)));
+	mask = _mm_movemask_ps(hit);
+	if (!mask) return -1;
+	_mm_storeu_ps(ts, t);
+	_mm_storeu_ps(us, u);
+	_mm_storeu_ps(vs, v);
+#else
+	for (int lane = 0; lane < 4; ++lane) {
+		glm::vec3 e1(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+		glm::vec3 e2(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+		glm::vec3 p = glm::cross(d, e2);
+		float inv_det = 1.0f / glm::dot(e1, p);
+		glm::vec3 s = o - glm::vec3(leaf.ax[lane], leaf.ay[lane], leaf.az[lane]);
+		glm::vec3 q = glm::cross(s, e1);
+		us[lane] = glm::dot(s, p) * inv_det;
+		vs[lane] = glm::dot(d, q) * inv_det;
+		ts[lane] = glm::dot(e2, q) * inv_det;
+		if (us[lane] >= 0.0f && vs[lane] >= 0.0f && us[lane] + vs[lane] <= 1.0f && ts[lane] >= 0.0f && ts[lane] < *t_) {
+			mask |= (1 << lane);
+		}
+	}
+	if (!mask) return -1;
+#endif
+	int best = -1;
+	for (int lane = 0; lane < 4; ++lane) {
+		if ((mask & (1 << lane)) && (best < 0 || ts[lane] < ts[best])) best = lane;
+	}
+	*t_ = ts[best];
+	*u_ = us[best];
+	*v_ = vs[best];
+	return best;
+}
+
+bool TriangleBVH::raycast(Ray const &ray, Hit *hit) const {
+	assert(hit);
+	RayBox box(ray);
+	float best_t = ray.max_t;
+	float best_u = 0.0f, best_v = 0.0f;
+	uint32_t best = -1U;
+
+	traverse([&](Node const &node){
+		return box.enter(node.min, node.max, best_t);
+	}, [&](Leaf const &leaf){
+		int lane = intersect_leaf(leaf, ray.origin, ray.direction, &best_t, &best_u, &best_v);
+		if (lane >= 0) best = leaf.triangle[lane];
+		return false;
+	});
+
+	if (best == -1U) return false;
+	hit->triangle = best;
+	hit->t = best_t;
+	hit->weights = glm::vec3(1.0f - best_u - best_v, best_u, best_v);
+	return true;
+}
+
+bool TriangleBVH::occluded(Ray const &ray) const {
+	RayBox box(ray);
+	float t = ray.max_t, u, v;
+	bool found = false;
+	traverse([&](Node const &node){
+		return box.enter(node.min, node.max, ray.max_t);
+	}, [&](Leaf const &leaf){
+		found = (intersect_leaf(leaf, ray.origin, ray.direction, &t, &u, &v) >= 0);
+		return found;
+	});
+	return found;
+}
+
+void TriangleBVH::raycast(Ray const *rays, uint32_t count, Hit *hits) const {
+	auto run = [this, rays, hits](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i) {
+			hits[i] = Hit();
+			raycast(rays[i], &hits[i]);
+		}
+	};
+	constexpr uint32_t Chunk = 256;
+	if (count <= Chunk) run(0, count);
+	else WorkerPool::shared().parallel_for(count, Chunk, run);
+}
+
+//------------------------------------------------
+//sphere sweeps + closest points (scalar; these are far less common than rays):
+
+//barycentric weights of (a point on the plane of) triangle abc:
+static glm::vec3 barycentric(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c, glm::vec3 const &p) {
+	glm::vec3 e1 = b - a, e2 = c - a, s = p - a;
+	float d11 = glm::dot(e1, e1), d12 = glm::dot(e1, e2), d22 = glm::dot(e2, e2);
+	float s1 = glm::dot(s, e1), s2 = glm::dot(s, e2);
+	float denom = d11 * d22 - d12 * d12;
+	if (denom == 0.0f) return glm::vec3(1.0f, 0.0f, 0.0f);
+	float v = (d22 * s1 - d12 * s2) / denom;
+	float w = (d11 * s2 - d12 * s1) / denom;
+	return glm::vec3(1.0f - v - w, v, w);
+}
+
+//first time a sphere at o moving along d touches the ball of 'radius' around c (or Infinity):
+static float sweep_point(glm::vec3 const &o, glm::vec3 const &d, float radius, glm::vec3 const &c) {
+	glm::vec3 m = o - c;
+	float k = glm::dot(m, m) - radius * radius;
+	if (k <= 0.0f) return 0.0f; //already touching
+	float a = glm::dot(d, d);
+	float b = glm::dot(m, d);
+	if (b >= 0.0f || a == 0.0f) return Infinity; //moving away
+	float disc = b * b - a * k;
+	if (disc < 0.0f) return Infinity;
+	return (-b - std::sqrt(disc)) / a;
+}
+
+//first time a sphere at o moving along d touches the capsule of 'radius' around segment pq (cylinder part only; or Infinity):
+static float sweep_segment(glm::vec3 const &o, glm::vec3 const &d, float radius, glm::vec3 const &p, glm::vec3 const &q, glm::vec3 *contact) {
+	glm::vec3 e = q - p, m = o - p;
+	float ee = glm::dot(e, e), me = glm::dot(m, e), de = glm::dot(d, e);
+	float dd = glm::dot(d, d), md = glm::dot(m, d);
+	float a = ee * dd - de * de;
+	float c = ee * (glm::dot(m, m) - radius * radius) - me * me;
+	float t;
+	if (std::abs(a) < 1e-12f * ee * dd) {
+		return Infinity; //moving parallel to the segment; the end spheres handle this
+	} else if (c <= 0.0f) {
+		t = 0.0f; //already inside the infinite cylinder
+	} else {
+		float b = ee * md - de * me;
+		float disc = b * b - a * c;
+		if (disc < 0.0f) return Infinity;
+		t = (-b - std::sqrt(disc)) / a;
+		if (t < 0.0f) return Infinity;
+	}
+	float s = me + t * de; //(position along segment, scaled by ee)
+	if (s < 0.0f || s > ee) return Infinity;
+	*contact = p + e * (s / ee);
+	return t;
+}
+
+bool TriangleBVH::sweep_sphere(Ray const &ray, float radius, Hit *hit) const {
+	assert(hit);
+	RayBox box(ray);
+	glm::vec3 const pad = glm::vec3(radius);
+	glm::vec3 const &o = ray.origin;
+	glm::vec3 const &d = ray.direction;
+	float best_t = ray.max_t;
+	uint32_t best = -1U;
+	glm::vec3 best_weights(0.0f);
+
+	traverse([&](Node const &node){
+		return box.enter(node.min - pad, node.max + pad, best_t);
+	}, [&](Leaf const &leaf){
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			if (leaf.triangle[lane] == -1U) continue;
+			glm::vec3 a(leaf.ax[lane], leaf.ay[lane], leaf.az[lane]);
+			glm::vec3 b = a + glm::vec3(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+			glm::vec3 c = a + glm::vec3(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+
+			auto consider = [&](float t, glm::vec3 const &contact) {
+				if (t < best_t) {
+					best_t = t;
+					best = leaf.triangle[lane];
+					best_weights = barycentric(a, b, c, contact);
+				}
+			};
+
+			//face: when the sphere reaches the plane (offset by 'radius'), is the touching point inside the triangle?
+			glm::vec3 n = glm::cross(b - a, c - a);
+			float n_len = glm::length(n);
+			if (n_len > 0.0f) {
+				n /= n_len;
+				float dist = glm::dot(o - a, n);
+				if (dist < 0.0f) {
+					n = -n;
+					dist = -dist;
+				}
+				float approach = -glm::dot(d, n);
+				float t = (dist <= radius ? 0.0f : (approach > 0.0f ? (dist - radius) / approach : Infinity));
+				if (t < best_t) {
+					glm::vec3 contact = o + t * d - n * std::min(dist, radius);
+					glm::vec3 w = barycentric(a, b, c, contact);
+					if (w.x >= 0.0f && w.y >= 0.0f && w.z >= 0.0f) {
+						consider(t, contact);
+						continue; //(a face contact comes before any edge or corner contact)
+					}
+				}
+			}
+
+			//edges + corners:
+			glm::vec3 contact;
+			for (auto const &edge : { std::make_pair(a, b), std::make_pair(b, c), std::make_pair(c, a) }) {
+				float t = sweep_segment(o, d, radius, edge.first, edge.second, &contact);
+				if (t < best_t) consider(t, contact);
+			}
+			for (glm::vec3 const &corner : { a, b, c }) {
+				float t = sweep_point(o, d, radius, corner);
+				if (t < best_t) consider(t, corner);
+			}
+		}
+		return false;
+	});
+
+	if (best == -1U) return false;
+	hit->triangle = best;
+	hit->t = best_t;
+	hit->weights = best_weights;
+	return true;
+}
+
+//closest point to p on triangle abc, as barycentric weights ("Real-Time Collision Detection", 5.1.5):
+static glm::vec3 closest_on_triangle(glm::vec3 const &p, glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return glm::vec3(1.0f, 0.0f, 0.0f);
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return glm::vec3(0.0f, 1.0f, 0.0f);
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float v = d1 / (d1 - d3);
+		return glm::vec3(1.0f - v, v, 0.0f);
+	}
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return glm::vec3(0.0f, 0.0f, 1.0f);
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float w = d2 / (d2 - d6);
+		return glm::vec3(1.0f - w, 0.0f, w);
+	}
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return glm::vec3(0.0f, 1.0f - w, w);
+	}
+
+	float denom = va + vb + vc;
+	if (denom == 0.0f) return glm::vec3(1.0f, 0.0f, 0.0f); //degenerate (collinear) triangle; the edge cases above cover it
+	float v = vb / denom;
+	float w = vc / denom;
+	return glm::vec3(1.0f - v - w, v, w);
+}
+
+bool TriangleBVH::closest_point(glm::vec3 const &point, Hit *hit, float max_distance) const {
+	assert(hit);
+	float best_dis2 = (max_distance == Infinity ? Infinity : max_distance * max_distance);
+	uint32_t best = -1U;
+	glm::vec3 best_weights(0.0f);
+
+	traverse([&](Node const &node){
+		glm::vec3 outside = glm::max(node.min - point, glm::max(glm::vec3(0.0f), point - node.max));
+		float dis2 = glm::dot(outside, outside);
+		return (dis2 <= best_dis2 ? dis2 : Infinity);
+	}, [&](Leaf const &leaf){
+		for (uint32_t lane = 0; lane < 4; ++lane) {
+			if (leaf.triangle[lane] == -1U) continue;
+			glm::vec3 a(leaf.ax[lane], leaf.ay[lane], leaf.az[lane]);
+			glm::vec3 b = a + glm::vec3(leaf.e1x[lane], leaf.e1y[lane], leaf.e1z[lane]);
+			glm::vec3 c = a + glm::vec3(leaf.e2x[lane], leaf.e2y[lane], leaf.e2z[lane]);
+			glm::vec3 w = closest_on_triangle(point, a, b, c);
+			glm::vec3 to = w.x * a + w.y * b + w.z * c - point;
+			float dis2 = glm::dot(to, to);
+			if (dis2 < best_dis2 || (best == -1U && dis2 <= best_dis2)) {
+				best_dis2 = dis2;
+				best = leaf.triangle[lane];
+				best_weights = w;
+			}
+		}
+		return false;
+	});
+
+	if (best == -1U) return false;
+	hit->triangle = best;
+	hit->t = std::sqrt(best_dis2);
+	hit->weights = best_weights;
+	return true;
+}
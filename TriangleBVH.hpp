@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+ * TriangleBVH is a bounding volume hierarchy over an indexed triangle list (e.g., a WalkMesh),
+ * for line-of-sight checks, ground snapping, and the like:
+ *  - raycast() finds the first hit along a ray; occluded() just checks for any hit
+ *  - raycast() over an array of rays spreads the work over WorkerPool::shared()
+ *  - sweep_sphere() finds the first contact of a moving sphere
+ *  - closest_point() finds the nearest point on any triangle
+ *
+ * The tree is built with binned surface-area-heuristic splits; leaves hold up to four
+ * triangles in structure-of-arrays form, so rays test a whole leaf at once with SSE
+ * (falling back to plain loops where SSE isn't available).
+ *
+ * Hits report barycentric weights in triangles[hit.triangle] order, so
+ *  WalkPoint(triangles[hit.triangle], hit.weights, hit.triangle) is a valid walk point.
+ */
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+
+struct TriangleBVH {
+	//build over 'triangles' (indices into 'vertices'); the BVH keeps its own copy of the geometry:
+	TriangleBVH(std::vector< glm::vec3 > const &vertices, std::vector< glm::uvec3 > const &triangles);
+	TriangleBVH() = default;
+
+	struct Ray {
+		glm::vec3 origin = glm::vec3(0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f); //need not be normalized; distances are in units of its length
+		float max_t = std::numeric_limits< float >::infinity();
+	};
+
+	struct Hit {
+		uint32_t triangle = -1U; //-1U => no hit
+		float t = std::numeric_limits< float >::infinity(); //hit position is origin + t * direction
+		glm::vec3 weights = glm::vec3(0.0f); //barycentric weights of hit position on 'triangle'
+	};
+
+	//first hit along 'ray', if any (returns false and leaves *hit alone if nothing hit):
+	bool raycast(Ray const &ray, Hit *hit) const;
+
+	//is anything hit along 'ray'? (cheaper than raycast, since any hit will do):
+	bool occluded(Ray const &ray) const;
+
+	//first hits for 'count' rays; hits[i].triangle is -1U where rays[i] hit nothing:
+	void raycast(Ray const *rays, uint32_t count, Hit *hits) const;
+
+	//first contact of a sphere of 'radius' centered at ray.origin moving along ray.direction;
+	// hit->weights is the contact point on the triangle:
+	bool sweep_sphere(Ray const &ray, float radius, Hit *hit) const;
+
+	//closest point on any triangle to 'point' within 'max_distance' (hit->t is the distance):
+	bool closest_point(glm::vec3 const &point, Hit *hit, float max_distance = std::numeric_limits< float >::infinity()) const;
+
+	//------ internals ------
+
+	struct Node {
+		glm::vec3 min = glm::vec3(0.0f);
+		uint32_t index = 0; //leaf: index of Leaf in 'leaves'; interior: index of second child (first child is the next node)
+		glm::vec3 max = glm::vec3(0.0f);
+		uint32_t count = 0; //leaf: number of triangles (1-4); interior: 0
+	};
+	std::vector< Node > nodes; //nodes[0] is the root (if there are any triangles)
+
+	//four triangles, as (corner, edge, edge) in structure-of-arrays form; unused slots have triangle == -1U and zero edges:
+	struct alignas(16) Leaf {
+		float ax[4], ay[4], az[4];
+		float e1x[4], e1y[4], e1z[4]; //b - a
+		float e2x[4], e2y[4], e2z[4]; //c - a
+		uint32_t triangle[4];
+	};
+	std::vector< Leaf > leaves;
+
+	//depth-first walk of nodes whose boxes 'enter' accepts, calling 'leaf' on each leaf reached:
+	template< typename Enter, typename VisitLeaf >
+	void traverse(Enter const &enter, VisitLeaf const &leaf) const;
+};
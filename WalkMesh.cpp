@@ -10,151 +10,220 @@
 #include <algorithm>
 #include <string>
 
-WalkMesh::WalkMesh(std::vector< glm::vec3 > const &vertices_, std::vector< glm::vec3 > const &normals_, std::vector< glm::uvec3 > const &triangles_)
-	: vertices(vertices_), normals(normals_), triangles(triangles_) {
-
-	//construct next_vertex map (maps each edge to the next vertex in the triangle):
-	next_vertex.reserve(triangles.size()*3);
-	auto do_next = [this](uint32_t a, uint32_t b, uint32_t c) {
-		auto ret = next_vertex.insert(std::make_pair(glm::uvec2(a,b), c));
-		assert(ret.second);
-	};
-	for (auto const &tri : triangles) {
-		do_next(tri.x, tri.y, tri.z);
-		do_next(tri.y, tri.z, tri.x);
-		do_next(tri.z, tri.x, tri.y);
-	}
-
-	//DEBUG: are vertex normals consistent with geometric normals?
-	for (auto const &tri : triangles) {
-		glm::vec3 const &a = vertices[tri.x];
-		glm::vec3 const &b = vertices[tri.y];
-		glm::vec3 const &c = vertices[tri.z];
-		glm::vec3 out = glm::normalize(glm::cross(b-a, c-a));
+WalkMesh::WalkMesh(std::vector< glm::vec3 > vertices_, std::vector< glm::vec3 > normals_, std::vector< glm::uvec3 > triangles_, Tables tables)
+	: vertices(std::move(vertices_)), normals(std::move(normals_)), triangles(std::move(triangles_)) {
 
-		float da = glm::dot(out, normals[tri.x]);
-		float db = glm::dot(out, normals[tri.y]);
-		float dc = glm::dot(out, normals[tri.z]);
+	bool cooked = true;
 
-		assert(da > 0.1f && db > 0.1f && dc > 0.1f);
+	if (!tables.neighbors.empty()) {
+		assert(tables.neighbors.size() == triangles.size());
+		neighbors = std::move(tables.neighbors);
+	} else {
+		cooked = false;
+		//pair up half-edges by sorting them on their (unordered) vertex pair:
+		struct HalfEdge {
+			uint64_t key; //(min vertex, max vertex)
+			uint32_t corner; //3 * triangle + edge
+			bool operator<(HalfEdge const &o) const { return key < o.key; }
+		};
+		std::vector< HalfEdge > half_edges;
+		half_edges.reserve(triangles.size() * 3);
+		for (uint32_t t = 0; t < triangles.size(); ++t) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t a = triangles[t][k];
+				uint32_t b = triangles[t][(k+1)%3];
+				half_edges.emplace_back(HalfEdge{ (uint64_t(std::min(a,b)) << 32) | std::max(a,b), 3 * t + k });
+			}
+		}
+		std::sort(half_edges.begin(), half_edges.end());
+
+		neighbors.assign(triangles.size(), glm::uvec3(-1U));
+		for (uint32_t i = 0; i + 1 < half_edges.size(); ++i) {
+			if (half_edges[i].key != half_edges[i+1].key) continue;
+			uint32_t c0 = half_edges[i].corner, c1 = half_edges[i+1].corner;
+			//edges should be shared by (at most) two triangles that traverse them in opposite directions:
+			assert(triangles[c0/3][c0%3] != triangles[c1/3][c1%3]);
+			assert(i + 2 >= half_edges.size() || half_edges[i+2].key != half_edges[i].key);
+			neighbors[c0/3][c0%3] = c1/3;
+			neighbors[c1/3][c1%3] = c0/3;
+			i += 1;
+		}
 	}
-}
 
-//project pt to the plane of triangle a,b,c and return the barycentric weights of the projected point:
-glm::vec3 barycentric_weights(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c, glm::vec3 const &pt) {
-
-	// From lecture in class
-	glm::vec3 norm = glm::cross(b-a, c-a);
-	glm::vec3 ab_perp = glm::cross(norm, b-a);
-	glm::vec3 bc_perp = glm::cross(norm, c-b);
-	glm::vec3 ca_perp = glm::cross(norm, a-c);
-
-	float abp_area = glm::dot(ab_perp, pt-a);
-	float bcp_area = glm::dot(bc_perp, pt-b);
-	float cap_area = glm::dot(ca_perp, pt-c);
-	float total = abp_area + bcp_area + cap_area;
-	return glm::vec3(bcp_area / total, cap_area / total, abp_area / total);
-
-	// Tried doing it myself first	
-	// Using this equation: https://www.baeldung.com/cs/3d-point-2d-plane
-	/*
-	glm::vec3 line1 = glm::vec3(b.x - a.x, b.y - a.y, b.z - a.z);
-	glm::vec3 line2 = glm::vec3(c.x - b.x, c.y - b.y, c.z - b.z);
-	float lenl1 = glm::length(line1);
-	float lenl2 = glm::length(line2);
-	glm::vec3 normal = glm::cross(line1, line2);	
-	float d = glm::dot(normal, line1); 
-	float len = glm::length(normal);
-	float k = (d - normal.x * pt.x, - normal.y * pt.y - normal.z * pt.z) / len;	
-	float newx = pt.x + k * normal.x;
-	float newy = pt.y + k * normal.y;
-	float newz = pt.z + k * normal.z;
-
-	// line1 opposite point c
-	glm::vec3 topoint1 = glm::vec3(newx - a.x, newy - a.y, newy - a.z);
-	float len1 = glm::length(topoint1);
-	float cos1 = glm::dot(topoint1, line1) / (len1 * lenl1);
-	float sin1 = 1.f - (cos1 * cos1);
-	float area_c = 0.5f * len1 * lenl1 * sin1; 
-
-	// line2, opposite point b
-	glm::vec3 topoint2 = glm::vec3(newx - b.x, newy - b.y, newy - b.z);
-	float len2 = glm::length(topoint2);
-	float cos2 = glm::dot(topoint2, line2) / (len2 * lenl2);
-	float sin2 = 1.f - (cos2 * cos2);
-	float area_b = 0.5f * len2 * lenl2 * sin2; 
-	float area_a = 1.f - area_b - area_c;
-
-	// printf("BARY: %f %f %f\n", area_a, area_b, area_c);
-	return glm::vec3(area_a, area_b, area_c);
-	*/
-}
+	vertex_triangle.assign(vertices.size(), -1U);
+	for (uint32_t t = 0; t < triangles.size(); ++t) {
+		vertex_triangle[triangles[t].x] = t;
+		vertex_triangle[triangles[t].y] = t;
+		vertex_triangle[triangles[t].z] = t;
+	}
 
-WalkPoint WalkMesh::nearest_walk_point(glm::vec3 const &world_point) const {
-	assert(!triangles.empty() && "Cannot start on an empty walkmesh");
+	if (!tables.barycentric_planes[0].empty()) {
+		for (uint32_t k = 0; k < 3; ++k) {
+			assert(tables.barycentric_planes[k].size() == triangles.size());
+			barycentric_planes[k] = std::move(tables.barycentric_planes[k]);
+		}
+	} else {
+		cooked = false;
+		//precompute barycentric planes, so that projecting a point to a triangle is just three dot products:
+		for (auto &planes : barycentric_planes) {
+			planes.resize(triangles.size());
+		}
+		for (uint32_t t = 0; t < triangles.size(); ++t) {
+			glm::vec3 const &a = vertices[triangles[t].x];
+			glm::vec3 const &b = vertices[triangles[t].y];
+			glm::vec3 const &c = vertices[triangles[t].z];
+			glm::vec3 norm = glm::cross(b-a, c-a);
+			float norm2 = glm::dot(norm, norm);
+			float inv_norm2 = (norm2 == 0.0f ? 0.0f : 1.0f / norm2); //degenerate triangles get all-zero weights
+
+			//weight of the corner opposite edge (from, to), as a function of position:
+			auto plane = [&](glm::vec3 const &from, glm::vec3 const &to) {
+				glm::vec3 perp = glm::cross(norm, to - from) * inv_norm2;
+				return glm::vec4(perp, -glm::dot(perp, from));
+			};
+			barycentric_planes[0][t] = plane(b, c);
+			barycentric_planes[1][t] = plane(c, a);
+			barycentric_planes[2][t] = plane(a, b);
+		}
+	}
 
-	WalkPoint closest;
-	float closest_dis2 = std::numeric_limits< float >::infinity();
+	if (!tables.bvh.nodes.empty() || triangles.empty()) {
+		bvh = std::move(tables.bvh);
+	} else {
+		cooked = false;
+		bvh = TriangleBVH(vertices, triangles);
+	}
 
-	for (auto const &tri : triangles) {
-		//find closest point on triangle:
+	#ifndef NDEBUG
+	//DEBUG: cooked walkmeshes were validated by walkmesh-cook; check the others here:
+	if (!cooked) {
+		try {
+			validate();
+		} catch (std::exception &e) {
+			std::cerr << "WalkMesh failed validation: " << e.what() << std::endl;
+			assert(0 && "invalid WalkMesh");
+		}
+	}
+	#endif
+	(void)cooked; //(only used by the debug check)
+}
 
+void WalkMesh::validate() const {
+	if (normals.size() != vertices.size()) {
+		throw std::runtime_error("has " + std::to_string(vertices.size()) + " vertices but " + std::to_string(normals.size()) + " normals");
+	}
+	for (uint32_t t = 0; t < triangles.size(); ++t) {
+		glm::uvec3 const &tri = triangles[t];
+		std::string which = "triangle " + std::to_string(t);
+		if (tri.x >= vertices.size() || tri.y >= vertices.size() || tri.z >= vertices.size()) {
+			throw std::runtime_error(which + " references a vertex out of range");
+		}
 		glm::vec3 const &a = vertices[tri.x];
 		glm::vec3 const &b = vertices[tri.y];
 		glm::vec3 const &c = vertices[tri.z];
+		glm::vec3 cross = glm::cross(b-a, c-a);
+		if (!(glm::length2(cross) > 0.0f)) {
+			throw std::runtime_error(which + " is degenerate");
+		}
 
-		//get barycentric coordinates of closest point in the plane of (a,b,c):
-		glm::vec3 coords = barycentric_weights(a,b,c, world_point);
-
-		//is that point inside the triangle?
-		if (coords.x >= 0.0f && coords.y >= 0.0f && coords.z >= 0.0f) {
-			//yes, point is inside triangle.
-			printf("COORDS: %f %f %f\n", coords.x, coords.y, coords.z);
-			float dis2 = glm::length2(world_point - to_world_point(WalkPoint(tri, coords)));
-			if (dis2 < closest_dis2) {
-				closest_dis2 = dis2;
-				closest.indices = tri;
-				closest.weights = coords;
+		//are vertex normals consistent with geometric normals?
+		glm::vec3 out = glm::normalize(cross);
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (!(glm::dot(out, normals[tri[k]]) > 0.1f)) {
+				throw std::runtime_error(which + " disagrees with the normal of vertex " + std::to_string(tri[k]));
 			}
-		} else {
-			//check triangle vertices and edges:
-			auto check_edge = [&world_point, &closest, &closest_dis2, this](uint32_t ai, uint32_t bi, uint32_t ci) {
-				glm::vec3 const &a = vertices[ai];
-				glm::vec3 const &b = vertices[bi];
-
-				//find closest point on line segment ab:
-				float along = glm::dot(world_point-a, b-a);
-				float max = glm::dot(b-a, b-a);
-				glm::vec3 pt;
-				glm::vec3 coords;
-				if (along < 0.0f) {
-					pt = a;
-					coords = glm::vec3(1.0f, 0.0f, 0.0f);
-				} else if (along > max) {
-					pt = b;
-					coords = glm::vec3(0.0f, 1.0f, 0.0f);
-				} else {
-					float amt = along / max;
-					pt = glm::mix(a, b, amt);
-					coords = glm::vec3(1.0f - amt, amt, 0.0f);
-				}
+		}
 
-				float dis2 = glm::length2(world_point - pt);
-				if (dis2 < closest_dis2) {
-					closest_dis2 = dis2;
-					closest.indices = glm::uvec3(ai, bi, ci);
-					closest.weights = coords;
-				}
-			};
-			check_edge(tri.x, tri.y, tri.z);
-			check_edge(tri.y, tri.z, tri.x);
-			check_edge(tri.z, tri.x, tri.y);
+		//do neighbors agree about sharing the edge?
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t n = neighbors[t][k];
+			if (n == -1U) continue;
+			glm::uvec3 const &across = triangles[n];
+			bool reversed = false;
+			for (uint32_t j = 0; j < 3; ++j) {
+				if (across[j] == tri[(k+1)%3] && across[(j+1)%3] == tri[k] && neighbors[n][j] == t) reversed = true;
+			}
+			if (!reversed) {
+				throw std::runtime_error(which + " and triangle " + std::to_string(n) + " don't share an edge in opposite directions");
+			}
 		}
 	}
-	assert(closest.indices.x < vertices.size());
-	assert(closest.indices.y < vertices.size());
-	assert(closest.indices.z < vertices.size());
-	return closest;
+
+	//every edge should be used at most once in each direction:
+	std::vector< uint64_t > directed;
+	directed.reserve(triangles.size() * 3);
+	for (auto const &tri : triangles) {
+		directed.emplace_back((uint64_t(tri.x) << 32) | tri.y);
+		directed.emplace_back((uint64_t(tri.y) << 32) | tri.z);
+		directed.emplace_back((uint64_t(tri.z) << 32) | tri.x);
+	}
+	std::sort(directed.begin(), directed.end());
+	auto dup = std::adjacent_find(directed.begin(), directed.end());
+	if (dup != directed.end()) {
+		throw std::runtime_error("edge (" + std::to_string(*dup >> 32) + ", " + std::to_string(*dup & 0xffffffff) + ") is used by more than one triangle in the same direction");
+	}
+}
+
+uint32_t WalkMesh::find_triangle(WalkPoint const &wp) const {
+	if (wp.triangle < triangles.size()) {
+		//the hint had better be a triangle with exactly these corners (otherwise barycentric_weights() would silently mix them up):
+		assert([&](){
+			glm::uvec3 const &tri = triangles[wp.triangle];
+			auto contains = [&tri](uint32_t v) { return tri.x == v || tri.y == v || tri.z == v; };
+			return contains(wp.indices.x) && contains(wp.indices.y) && contains(wp.indices.z);
+		}() && "WalkPoint's triangle hint doesn't match its indices.");
+		return wp.triangle;
+	}
+
+	//no hint; walk the fan of triangles around wp.indices.x, first one way, then the other:
+	uint32_t pivot = wp.indices.x;
+	auto matches = [this, &wp](uint32_t t) {
+		glm::uvec3 const &tri = triangles[t];
+		auto contains = [&tri](uint32_t v) { return tri.x == v || tri.y == v || tri.z == v; };
+		return contains(wp.indices.y) && contains(wp.indices.z);
+	};
+	uint32_t first = (pivot < vertex_triangle.size() ? vertex_triangle[pivot] : -1U);
+	for (uint32_t pass = 0; pass < 2 && first != -1U; ++pass) {
+		uint32_t t = first;
+		do {
+			if (matches(t)) return t;
+			glm::uvec3 const &tri = triangles[t];
+			uint32_t k = (tri.x == pivot ? 0 : (tri.y == pivot ? 1 : 2));
+			//cross edge (pivot, next) on the first pass, edge (prev, pivot) on the second:
+			t = neighbors[t][pass == 0 ? k : (k + 2) % 3];
+		} while (t != -1U && t != first);
+		if (t == first) break; //fan was closed, so the first pass saw all of it
+	}
+	assert(0 && "WalkPoint is not on a triangle of this WalkMesh.");
+	return -1U;
+}
+
+glm::vec3 WalkMesh::barycentric_weights(WalkPoint const &wp, uint32_t t, glm::vec3 const &pt) const {
+	glm::vec4 p(pt, 1.0f);
+	glm::vec3 weights(
+		glm::dot(barycentric_planes[0][t], p),
+		glm::dot(barycentric_planes[1][t], p),
+		glm::dot(barycentric_planes[2][t], p)
+	);
+
+	//walkpoint indices may be any permutation of the triangle's corners:
+	glm::uvec3 const &tri = triangles[t];
+	auto slot = [&tri](uint32_t v) {
+		return (v == tri.x ? 0 : (v == tri.y ? 1 : 2));
+	};
+	return glm::vec3(weights[slot(wp.indices.x)], weights[slot(wp.indices.y)], weights[slot(wp.indices.z)]);
+}
+
+WalkPoint WalkMesh::nearest_walk_point(glm::vec3 const &world_point) const {
+	assert(!triangles.empty() && "Cannot start on an empty walkmesh");
+
+	//closest point over all triangles, found by descending the bvh nearest-box-first:
+	TriangleBVH::Hit hit;
+	bool found = bvh.closest_point(world_point, &hit);
+	assert(found && hit.triangle < triangles.size());
+	(void)found;
+
+	return to_walk_point(hit);
 }
 
 
@@ -165,13 +234,10 @@ void WalkMesh::walk_in_triangle(WalkPoint const &start, glm::vec3 const &step, W
 	assert(time_);
 	auto &time = *time_;
 
-	glm::vec3 const &a = vertices[start.indices.x];
-	glm::vec3 const &b = vertices[start.indices.y];
-	glm::vec3 const &c = vertices[start.indices.z];
-
+	uint32_t triangle = find_triangle(start);
 
 	glm::vec3 end_world = to_world_point(start) + step;
-	glm::vec3 end_bary = barycentric_weights(a,b,c, end_world);
+	glm::vec3 end_bary = barycentric_weights(start, triangle, end_world);
 	glm::vec3 delta_bary = end_bary - start.weights;
 
 	// Went outside of triangle
@@ -200,6 +266,7 @@ void WalkMesh::walk_in_triangle(WalkPoint const &start, glm::vec3 const &step, W
 
 		end.indices = start.indices;
 		end.weights = start.weights + delta_bary * timepassed;
+		end.triangle = triangle;
 
 		if (xyorz == 0) {
 			// y becomes x, z becomes y, x becomes z
@@ -232,6 +299,7 @@ void WalkMesh::walk_in_triangle(WalkPoint const &start, glm::vec3 const &step, W
 	else {
 		end.indices = start.indices;
 		end.weights = end_bary;
+		end.triangle = triangle;
 		time = 1.f;
 	}
 }
@@ -247,17 +315,28 @@ bool WalkMesh::cross_edge(WalkPoint const &start, WalkPoint *end_, glm::quat *ro
 	assert(start.weights.z == 0.0f); //*must* be on an edge.
 	glm::uvec2 edge = glm::uvec2(start.indices);
 
-	auto it = next_vertex.find(edge);
+	//the triangle containing directed edge (edge.x, edge.y) -- the current triangle, or the one across its (edge.y, edge.x):
+	uint32_t t = find_triangle(start);
+	glm::uvec3 const &current = triangles[t];
+	uint32_t owner = -1U;
+	for (uint32_t k = 0; k < 3; ++k) {
+		if (current[k] == edge.x && current[(k+1)%3] == edge.y) owner = t;
+		if (current[k] == edge.y && current[(k+1)%3] == edge.x) owner = neighbors[t][k];
+	}
+
 	end = start;
 	rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 
-	if (it == next_vertex.end()) {
+	if (owner == -1U) {
 		return false;
 	} else {
-		int newz = (*it).second;
+		//the vertex of that triangle which isn't on the edge:
+		glm::uvec3 const &tri = triangles[owner];
+		uint32_t newz = (tri.x != edge.x && tri.x != edge.y ? tri.x : (tri.y != edge.x && tri.y != edge.y ? tri.y : tri.z));
 		
 		end.indices = glm::uvec3(start.indices.y, start.indices.x, newz);
 		end.weights = glm::vec3(start.weights.y, start.weights.x, 0.0f);
+		end.triangle = owner;
 
 		rotation = glm::rotation(to_world_triangle_normal(start), to_world_triangle_normal(end));
 		return true;
@@ -280,15 +359,25 @@ WalkMeshes::WalkMeshes(std::string const &filename) {
 	std::vector< char > names;
 	read_chunk(file, "str0", &names);
 
-	struct IndexEntry {
-		uint32_t name_begin, name_end;
-		uint32_t vertex_begin, vertex_end;
-		uint32_t triangle_begin, triangle_end;
-	};
-
 	std::vector< IndexEntry > index;
 	read_chunk(file, "idxA", &index);
 
+	//precomputed tables from walkmesh-cook (optional; built on load if missing):
+	std::vector< glm::uvec3 > adjacency;
+	if (peek_chunk(file, "adj0")) read_chunk(file, "adj0", &adjacency);
+
+	std::vector< Frame > frames;
+	if (peek_chunk(file, "frm0")) read_chunk(file, "frm0", &frames);
+
+	std::vector< BVHIndexEntry > bvh_index;
+	std::vector< TriangleBVH::Node > bvh_nodes;
+	std::vector< TriangleBVH::Leaf > bvh_leaves;
+	if (peek_chunk(file, "bvhi")) {
+		read_chunk(file, "bvhi", &bvh_index);
+		read_chunk(file, "bvh0", &bvh_nodes);
+		read_chunk(file, "bvh1", &bvh_leaves);
+	}
+
 	if (file.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in walkmesh file '" << filename << "'" << std::endl;
 	}
@@ -298,8 +387,19 @@ WalkMeshes::WalkMeshes(std::string const &filename) {
 	if (vertices.size() != normals.size()) {
 		throw std::runtime_error("Mis-matched position and normal sizes in '" + filename + "'");
 	}
+	if (!adjacency.empty() && adjacency.size() != triangles.size()) {
+		throw std::runtime_error("Mis-matched adjacency and triangle sizes in '" + filename + "'");
+	}
+	if (!frames.empty() && frames.size() != triangles.size()) {
+		throw std::runtime_error("Mis-matched frame and triangle sizes in '" + filename + "'");
+	}
+	if (!bvh_index.empty() && bvh_index.size() != index.size()) {
+		throw std::runtime_error("Mis-matched bvh index and index sizes in '" + filename + "'");
+	}
+	cooked = !adjacency.empty() && !frames.empty() && !bvh_index.empty();
 
-	for (auto const &e : index) {
+	for (uint32_t i = 0; i < index.size(); ++i) {
+		auto const &e = index[i];
 		if (!(e.name_begin <= e.name_end && e.name_end <= names.size())) {
 			throw std::runtime_error("Invalid name indices in index of '" + filename + "'");
 		}
@@ -310,28 +410,92 @@ WalkMeshes::WalkMeshes(std::string const &filename) {
 			throw std::runtime_error("Invalid triangle indices in index of '" + filename + "'");
 		}
 
-		//copy vertices/normals:
-		std::vector< glm::vec3 > wm_vertices(vertices.begin() + e.vertex_begin, vertices.begin() + e.vertex_end);
-		std::vector< glm::vec3 > wm_normals(normals.begin() + e.vertex_begin, normals.begin() + e.vertex_end);
-
-		//remap triangles:
-		std::vector< glm::uvec3 > wm_triangles; wm_triangles.reserve(e.triangle_end - e.triangle_begin);
+		//check that triangles only reference this mesh's vertices with a single min/max pass
+		// (branch-free, so the compiler can vectorize it):
+		uint32_t lowest = -1U;
+		uint32_t highest = 0;
 		for (uint32_t ti = e.triangle_begin; ti != e.triangle_end; ++ti) {
-			if (!( (e.vertex_begin <= triangles[ti].x && triangles[ti].x < e.vertex_end)
-			    && (e.vertex_begin <= triangles[ti].y && triangles[ti].y < e.vertex_end)
-			    && (e.vertex_begin <= triangles[ti].z && triangles[ti].z < e.vertex_end) )) {
-				throw std::runtime_error("Invalid triangle in '" + filename + "'");
+			glm::uvec3 const &tri = triangles[ti];
+			lowest = std::min(lowest, std::min(tri.x, std::min(tri.y, tri.z)));
+			highest = std::max(highest, std::max(tri.x, std::max(tri.y, tri.z)));
+		}
+		if (e.triangle_begin != e.triangle_end && (lowest < e.vertex_begin || highest >= e.vertex_end)) {
+			throw std::runtime_error("Invalid triangle in '" + filename + "'");
+		}
+
+		std::vector< glm::vec3 > wm_vertices;
+		std::vector< glm::vec3 > wm_normals;
+		std::vector< glm::uvec3 > wm_triangles;
+
+		//if this mesh is the last user of the file's arrays and spans all of them (e.g., a single-mesh file), take them over;
+		// otherwise copy just this mesh's ranges:
+		bool take_all = (i + 1 == index.size())
+			&& e.vertex_begin == 0 && e.vertex_end == vertices.size()
+			&& e.triangle_begin == 0 && e.triangle_end == triangles.size();
+		if (take_all) {
+			wm_vertices = std::move(vertices);
+			wm_normals = std::move(normals);
+			wm_triangles = std::move(triangles);
+		} else {
+			wm_vertices.assign(vertices.begin() + e.vertex_begin, vertices.begin() + e.vertex_end);
+			wm_normals.assign(normals.begin() + e.vertex_begin, normals.begin() + e.vertex_end);
+			wm_triangles.assign(triangles.begin() + e.triangle_begin, triangles.begin() + e.triangle_end);
+		}
+
+		//rebase triangles (in place) to index this mesh's vertices:
+		if (e.vertex_begin != 0) {
+			glm::uvec3 base = glm::uvec3(e.vertex_begin);
+			for (auto &tri : wm_triangles) {
+				tri -= base;
 			}
-			wm_triangles.emplace_back(
-				triangles[ti].x - e.vertex_begin,
-				triangles[ti].y - e.vertex_begin,
-				triangles[ti].z - e.vertex_begin
-			);
 		}
-		
+
 		std::string name(names.begin() + e.name_begin, names.begin() + e.name_end);
 
-		auto ret = meshes.emplace(name, WalkMesh(wm_vertices, wm_normals, wm_triangles));
+		//pick up this mesh's slice of any precomputed tables:
+		WalkMesh::Tables tables;
+		uint32_t triangle_count = e.triangle_end - e.triangle_begin;
+		if (!adjacency.empty()) {
+			tables.neighbors.assign(adjacency.begin() + e.triangle_begin, adjacency.begin() + e.triangle_end);
+			for (glm::uvec3 const &n : tables.neighbors) {
+				if ((n.x != -1U && n.x >= triangle_count) || (n.y != -1U && n.y >= triangle_count) || (n.z != -1U && n.z >= triangle_count)) {
+					throw std::runtime_error("Invalid adjacency for '" + name + "' in '" + filename + "'");
+				}
+			}
+		}
+		if (!frames.empty()) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				tables.barycentric_planes[k].reserve(triangle_count);
+				for (uint32_t ti = e.triangle_begin; ti != e.triangle_end; ++ti) {
+					tables.barycentric_planes[k].emplace_back(frames[ti].planes[k]);
+				}
+			}
+		}
+		if (!bvh_index.empty()) {
+			BVHIndexEntry const &b = bvh_index[i];
+			if (!(b.node_begin <= b.node_end && b.node_end <= bvh_nodes.size() && b.leaf_begin <= b.leaf_end && b.leaf_end <= bvh_leaves.size())) {
+				throw std::runtime_error("Invalid bvh indices in index of '" + filename + "'");
+			}
+			uint32_t node_count = b.node_end - b.node_begin;
+			uint32_t leaf_count = b.leaf_end - b.leaf_begin;
+			tables.bvh.nodes.assign(bvh_nodes.begin() + b.node_begin, bvh_nodes.begin() + b.node_end);
+			tables.bvh.leaves.assign(bvh_leaves.begin() + b.leaf_begin, bvh_leaves.begin() + b.leaf_end);
+			for (uint32_t ni = 0; ni < node_count; ++ni) {
+				TriangleBVH::Node const &node = tables.bvh.nodes[ni];
+				if (node.count ? (node.count > 4 || node.index >= leaf_count) : (node.index <= ni + 1 || node.index >= node_count)) {
+					throw std::runtime_error("Invalid bvh node for '" + name + "' in '" + filename + "'");
+				}
+			}
+			for (auto const &leaf : tables.bvh.leaves) {
+				for (uint32_t t : leaf.triangle) {
+					if (t != -1U && t >= triangle_count) {
+						throw std::runtime_error("Invalid bvh leaf for '" + name + "' in '" + filename + "'");
+					}
+				}
+			}
+		}
+
+		auto ret = meshes.emplace(name, WalkMesh(std::move(wm_vertices), std::move(wm_normals), std::move(wm_triangles), std::move(tables)));
 		if (!ret.second) {
 			throw std::runtime_error("WalkMesh with duplicated name '" + name + "' in '" + filename + "'");
 		}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "TriangleBVH.hpp"
+
 #include <glm/glm.hpp>
-#include <glm/gtx/hash.hpp> //allows the use of 'uvec2' as an unordered_map key
+#include <glm/gtc/quaternion.hpp>
 
 #include <vector>
 #include <string>
@@ -14,7 +16,9 @@ struct WalkPoint {
 	//barycentric coordinates for current point:
 	glm::vec3 weights = glm::vec3(std::numeric_limits< float >::quiet_NaN());
 	//NOTE: by convention, if WalkPoint is on an edge, indices/weights will be arranged so that weights.z will be 0.0.
-	WalkPoint(glm::uvec3 const &indices_, glm::vec3 const &weights_) : indices(indices_), weights(weights_) { }
+	//index of the current triangle in WalkMesh::triangles (a hint; if -1U, WalkMesh looks it up from 'indices'):
+	uint32_t triangle = -1U;
+	WalkPoint(glm::uvec3 const &indices_, glm::vec3 const &weights_, uint32_t triangle_ = -1U) : indices(indices_), weights(weights_), triangle(triangle_) { }
 	WalkPoint() = default;
 };
 
@@ -24,11 +28,35 @@ struct WalkMesh {
 	std::vector< glm::vec3 > normals; //normals for interpolated 'up' direction
 	std::vector< glm::uvec3 > triangles; //CCW-oriented
 
-	//This "next vertex" map includes [a,b]->c, [b,c]->a, and [c,a]->b for each triangle (a,b,c), and is useful for checking what's over an edge from a given point:
-	std::unordered_map< glm::uvec2, uint32_t > next_vertex;
+	//Triangle across each edge (xy, yz, zx) of each triangle, or -1U for boundary edges:
+	std::vector< glm::uvec3 > neighbors;
+
+	//Some triangle using each vertex (a starting point for finding triangles around the vertex), or -1U if unused:
+	std::vector< uint32_t > vertex_triangle;
+
+	//Per-triangle barycentric tables (structure-of-arrays, one array per triangle corner):
+	// the barycentric weight of triangles[t][k] at point p (projected to the triangle's plane) is
+	//   dot(glm::vec3(barycentric_planes[k][t]), p) + barycentric_planes[k][t].w
+	// (i.e., the opposite edge's in-plane perpendicular, scaled by 1 / (2 * area)^2)
+	std::vector< glm::vec4 > barycentric_planes[3];
+
+	//Acceleration structure for raycasts, sphere sweeps, and closest-point queries against the walkmesh:
+	TriangleBVH bvh;
+
+	//Precomputed tables (e.g., loaded from chunks written by walkmesh-cook):
+	struct Tables {
+		std::vector< glm::uvec3 > neighbors;
+		std::vector< glm::vec4 > barycentric_planes[3];
+		TriangleBVH bvh;
+	};
+
+	//Construct new WalkMesh, building whichever of neighbors, barycentric_planes, and bvh aren't supplied in 'tables':
+	// (arguments are taken by value -- std::move() them in to avoid copying)
+	WalkMesh(std::vector< glm::vec3 > vertices_, std::vector< glm::vec3 > normals_, std::vector< glm::uvec3 > triangles_, Tables tables = Tables());
 
-	//Construct new WalkMesh and build next_vertex structure:
-	WalkMesh(std::vector< glm::vec3 > const &vertices_, std::vector< glm::vec3 > const &normals_, std::vector< glm::uvec3 > const &triangles_);
+	//check that the walkmesh is well-formed (indices in range, no degenerate triangles, edges shared by at most two
+	// consistently-oriented triangles, vertex normals that agree with triangle normals); throws std::runtime_error if not:
+	void validate() const;
 
 	//used to initialize walking -- finds the closest point on the walk mesh:
 	// (should only need to call this at the start of a level)
@@ -64,6 +92,17 @@ struct WalkMesh {
 		glm::quat *rotation     //[out] rotation over edge
 	) const;
 
+	//find the triangle a walkpoint is on (uses wp.triangle if set, otherwise searches around wp.indices.x):
+	uint32_t find_triangle(WalkPoint const &wp) const;
+
+	//barycentric weights of (the projection of) 'pt' with respect to wp's triangle, in wp.indices order:
+	glm::vec3 barycentric_weights(WalkPoint const &wp, uint32_t triangle, glm::vec3 const &pt) const;
+
+	//walkpoint at a bvh query result (e.g., where a ray hit the ground):
+	WalkPoint to_walk_point(TriangleBVH::Hit const &hit) const {
+		return WalkPoint(triangles[hit.triangle], hit.weights, hit.triangle);
+	}
+
 	//used to read back results of walking:
 	glm::vec3 to_world_point(WalkPoint const &wp) const {
 		//if you were looking here for the lesson solution, well, here you go:
@@ -99,6 +138,23 @@ struct WalkMeshes {
 	//retrieve a WalkMesh by name:
 	WalkMesh const &lookup(std::string const &name) const;
 
+	//file format: "p...", "n...", "tri0", "str0", and "idxA" chunks, then (optionally, from walkmesh-cook)
+	// "adj0" (mesh-relative WalkMesh::neighbors, parallel to "tri0"), "frm0" (Frames, parallel to "tri0"),
+	// and "bvhi" (BVHIndexEntry, parallel to "idxA"), "bvh0" (TriangleBVH::Node), "bvh1" (TriangleBVH::Leaf):
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_begin, vertex_end;
+		uint32_t triangle_begin, triangle_end;
+	};
+	struct Frame {
+		glm::vec4 planes[3]; //WalkMesh::barycentric_planes[0-2][t]
+	};
+	struct BVHIndexEntry {
+		uint32_t node_begin, node_end; //(node indices are relative to node_begin)
+		uint32_t leaf_begin, leaf_end; //(leaf indices are relative to leaf_begin, triangles to the mesh's triangle_begin)
+	};
+
 	//internals:
 	std::unordered_map< std::string, WalkMesh > meshes;
+	bool cooked = false; //were adjacency, barycentric planes, and bvh read from the file?
 };
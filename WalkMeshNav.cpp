@@ -0,0 +1,213 @@
+#include "WalkMeshNav.hpp"
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <queue>
+
+WalkMeshNav::WalkMeshNav(WalkMesh const &walkmesh_) : walkmesh(walkmesh_) {
+	centroids.resize(walkmesh.triangles.size());
+	for (uint32_t t = 0; t < walkmesh.triangles.size(); ++t) {
+		glm::uvec3 const &tri = walkmesh.triangles[t];
+		centroids[t] = (walkmesh.vertices[tri.x] + walkmesh.vertices[tri.y] + walkmesh.vertices[tri.z]) / 3.0f;
+	}
+}
+
+WalkMeshNav::Path WalkMeshNav::find_path(WalkPoint const &start, WalkPoint const &goal) const {
+	Path path;
+	uint32_t start_triangle = walkmesh.find_triangle(start);
+	uint32_t goal_triangle = walkmesh.find_triangle(goal);
+
+	if (!find_corridor(start_triangle, goal_triangle, &path.corridor)) return path;
+
+	path.found = true;
+	string_pull(walkmesh.to_world_point(start), walkmesh.to_world_point(goal), path.corridor, &path.points);
+	return path;
+}
+
+std::future< std::vector< WalkMeshNav::Path > > WalkMeshNav::find_paths_async(std::vector< Query > queries) const {
+	auto done = std::make_shared< std::promise< std::vector< Path > > >();
+	std::future< std::vector< Path > > result = done->get_future();
+
+	auto batch = std::make_shared< std::vector< Query > >(std::move(queries));
+	WorkerPool::shared().run([this, batch, done](){
+		try {
+			std::vector< Path > paths(batch->size());
+			WorkerPool::shared().parallel_for(uint32_t(batch->size()), 16, [&](uint32_t begin, uint32_t end){
+				for (uint32_t i = begin; i < end; ++i) {
+					paths[i] = find_path((*batch)[i].start, (*batch)[i].goal);
+				}
+			});
+			done->set_value(std::move(paths));
+		} catch (...) {
+			done->set_exception(std::current_exception());
+		}
+	});
+
+	return result;
+}
+
+void WalkMeshNav::clear_cache() {
+	std::unique_lock< std::mutex > lock(cache_mutex);
+	cache.clear();
+}
+
+bool WalkMeshNav::find_corridor(uint32_t start, uint32_t goal, std::vector< uint32_t > *corridor_) const {
+	assert(corridor_);
+	auto &corridor = *corridor_;
+
+	if (start == goal) {
+		corridor.assign(1, start);
+		return true;
+	}
+
+	{ //cached?
+		std::unique_lock< std::mutex > lock(cache_mutex);
+		auto f = cache.find(glm::uvec2(start, goal));
+		if (f != cache.end()) {
+			cache_hits += 1;
+			corridor = f->second;
+			return !corridor.empty();
+		}
+		cache_misses += 1;
+	}
+
+	//per-thread search state; 'visited' stamps mean the arrays never need clearing:
+	struct Scratch {
+		std::vector< float > cost;
+		std::vector< uint32_t > from;
+		std::vector< uint32_t > visited;
+		uint32_t stamp = 0;
+	};
+	static thread_local Scratch scratch;
+	if (scratch.visited.size() != centroids.size()) {
+		scratch.cost.assign(centroids.size(), 0.0f);
+		scratch.from.assign(centroids.size(), -1U);
+		scratch.visited.assign(centroids.size(), 0);
+		scratch.stamp = 0;
+	}
+	scratch.stamp += 1;
+	if (scratch.stamp == 0) { //wrapped around; start fresh
+		std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+		scratch.stamp = 1;
+	}
+
+	//open list of (estimated total cost, triangle), with stale entries skipped when popped:
+	typedef std::pair< float, uint32_t > Entry;
+	std::priority_queue< Entry, std::vector< Entry >, std::greater< Entry > > open;
+
+	glm::vec3 const &target = centroids[goal];
+	scratch.visited[start] = scratch.stamp;
+	scratch.cost[start] = 0.0f;
+	scratch.from[start] = -1U;
+	open.emplace(glm::distance(centroids[start], target), start);
+
+	bool reached = false;
+	while (!open.empty()) {
+		auto [estimate, t] = open.top();
+		open.pop();
+		if (t == goal) {
+			reached = true;
+			break;
+		}
+		//stale entry (a cheaper route to t was found after this was queued)?
+		if (estimate > scratch.cost[t] + glm::distance(centroids[t], target)) continue;
+
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t n = walkmesh.neighbors[t][k];
+			if (n == -1U) continue;
+			float cost = scratch.cost[t] + glm::distance(centroids[t], centroids[n]);
+			if (scratch.visited[n] == scratch.stamp && scratch.cost[n] <= cost) continue;
+			scratch.visited[n] = scratch.stamp;
+			scratch.cost[n] = cost;
+			scratch.from[n] = t;
+			open.emplace(cost + glm::distance(centroids[n], target), n);
+		}
+	}
+
+	corridor.clear();
+	if (reached) {
+		for (uint32_t t = goal; t != -1U; t = scratch.from[t]) {
+			corridor.emplace_back(t);
+		}
+		std::reverse(corridor.begin(), corridor.end());
+	}
+
+	{ //remember for next time:
+		std::unique_lock< std::mutex > lock(cache_mutex);
+		if (cache.size() >= cache_capacity) cache.clear();
+		cache.emplace(glm::uvec2(start, goal), corridor);
+	}
+
+	return reached;
+}
+
+void WalkMeshNav::string_pull(glm::vec3 const &start, glm::vec3 const &goal, std::vector< uint32_t > const &corridor, std::vector< glm::vec3 > *points_) const {
+	assert(points_);
+	auto &points = *points_;
+
+	//portals as (left, right) as seen when walking the corridor; first and last are just the endpoints:
+	std::vector< std::pair< glm::vec3, glm::vec3 > > portals;
+	portals.reserve(corridor.size() + 1);
+	portals.emplace_back(start, start);
+	for (uint32_t i = 0; i + 1 < corridor.size(); ++i) {
+		glm::uvec3 const &tri = walkmesh.triangles[corridor[i]];
+		glm::uvec3 const &across = walkmesh.neighbors[corridor[i]];
+		uint32_t k = (across.x == corridor[i+1] ? 0 : (across.y == corridor[i+1] ? 1 : 2));
+		assert(across[k] == corridor[i+1]);
+		//leaving a CCW triangle over edge (a,b), 'b' is on the left and 'a' on the right:
+		portals.emplace_back(walkmesh.vertices[tri[(k+1)%3]], walkmesh.vertices[tri[k]]);
+	}
+	portals.emplace_back(goal, goal);
+
+	//> 0 if 'b' is counterclockwise from 'a' (as seen from above, about 'apex'):
+	auto turn = [](glm::vec3 const &apex, glm::vec3 const &a, glm::vec3 const &b) {
+		glm::vec2 u = glm::vec2(a - apex);
+		glm::vec2 v = glm::vec2(b - apex);
+		return u.x * v.y - u.y * v.x;
+	};
+
+	points.clear();
+	points.emplace_back(start);
+
+	glm::vec3 apex = start, left = start, right = start;
+	uint32_t apex_index = 0, left_index = 0, right_index = 0;
+	for (uint32_t i = 1; i < portals.size(); ++i) {
+		glm::vec3 const &next_left = portals[i].first;
+		glm::vec3 const &next_right = portals[i].second;
+
+		//does the new right edge narrow the funnel?
+		if (turn(apex, right, next_right) >= 0.0f) {
+			if (apex == right || turn(apex, left, next_right) < 0.0f) {
+				right = next_right;
+				right_index = i;
+			} else {
+				//right crossed over left, so left is a corner of the path; restart from there:
+				if (points.back() != left) points.emplace_back(left);
+				apex = right = left;
+				apex_index = right_index = left_index;
+				i = apex_index;
+				continue;
+			}
+		}
+
+		//does the new left edge narrow the funnel?
+		if (turn(apex, left, next_left) <= 0.0f) {
+			if (apex == left || turn(apex, right, next_left) > 0.0f) {
+				left = next_left;
+				left_index = i;
+			} else {
+				//left crossed over right, so right is a corner of the path; restart from there:
+				if (points.back() != right) points.emplace_back(right);
+				apex = left = right;
+				apex_index = left_index = right_index;
+				i = apex_index;
+				continue;
+			}
+		}
+	}
+
+	if (points.back() != goal) points.emplace_back(goal);
+}
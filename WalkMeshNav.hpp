@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+ * WalkMeshNav answers "how do I get from here to there?" on a WalkMesh:
+ *  - the navigation graph has one node per triangle (at its centroid), linked across shared edges
+ *  - A* over that graph finds a corridor of triangles; corridors are cached by (start, goal) triangle
+ *  - the funnel algorithm string-pulls the corridor into a short list of corner points
+ *
+ * Many agents can ask at once with find_paths_async(), which runs the queries on WorkerPool::shared().
+ *
+ * String-pulling happens in the xy plane (z is up in this game), which is right for
+ * walkmeshes that don't fold back over themselves; the path points keep their full 3D positions.
+ */
+
+#include "WalkMesh.hpp"
+
+#include <glm/gtx/hash.hpp> //allows the use of 'uvec2' as an unordered_map key
+
+#include <future>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+struct WalkMeshNav {
+	//'walkmesh' must outlive the WalkMeshNav:
+	WalkMeshNav(WalkMesh const &walkmesh);
+
+	WalkMeshNav(WalkMeshNav const &) = delete;
+	WalkMeshNav &operator=(WalkMeshNav const &) = delete;
+
+	struct Path {
+		bool found = false;
+		std::vector< glm::vec3 > points; //world-space corners from start to goal (inclusive); empty if !found
+		std::vector< uint32_t > corridor; //triangles visited, in order
+	};
+
+	//find a path between two points on the walkmesh; safe to call from any thread:
+	Path find_path(WalkPoint const &start, WalkPoint const &goal) const;
+
+	struct Query {
+		WalkPoint start;
+		WalkPoint goal;
+	};
+
+	//find paths for a batch of queries on worker threads (results are in query order).
+	// the WalkMeshNav must stay alive until the future is ready:
+	std::future< std::vector< Path > > find_paths_async(std::vector< Query > queries) const;
+
+	//forget cached corridors:
+	void clear_cache();
+
+	//------ internals ------
+	WalkMesh const &walkmesh;
+
+	//graph node positions (links are walkmesh.neighbors):
+	std::vector< glm::vec3 > centroids;
+
+	//A* over triangle centroids; returns false if 'goal' is unreachable from 'start':
+	bool find_corridor(uint32_t start, uint32_t goal, std::vector< uint32_t > *corridor) const;
+
+	//funnel algorithm over the portals of 'corridor':
+	void string_pull(glm::vec3 const &start, glm::vec3 const &goal, std::vector< uint32_t > const &corridor, std::vector< glm::vec3 > *points) const;
+
+	//corridor cache (empty corridor => unreachable); cleared wholesale when it reaches 'cache_capacity':
+	mutable std::mutex cache_mutex;
+	mutable std::unordered_map< glm::uvec2, std::vector< uint32_t > > cache;
+	uint32_t cache_capacity = 4096;
+	mutable uint32_t cache_hits = 0;
+	mutable uint32_t cache_misses = 0;
+};
@@ -0,0 +1,130 @@
+#include "WorkerPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <iostream>
+
+WorkerPool::WorkerPool(uint32_t threads) {
+	if (threads == 0) {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		threads = std::max(1U, hardware > 1 ? hardware - 1 : 1U);
+	}
+
+	workers.reserve(threads);
+	for (uint32_t i = 0; i < threads; ++i) {
+		workers.emplace_back([this](){
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				work_cv.wait(lock, [this](){ return quit || !jobs.empty(); });
+				if (jobs.empty()) break; //quitting, and nothing left to do
+
+				std::function< void() > job = std::move(jobs.front());
+				jobs.pop_front();
+				running += 1;
+				lock.unlock();
+
+				try {
+					job();
+				} catch (std::exception &e) {
+					std::cerr << "WorkerPool job threw: " << e.what() << std::endl;
+				}
+
+				lock.lock();
+				running -= 1;
+				if (running == 0 && jobs.empty()) done_cv.notify_all();
+			}
+		});
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	work_cv.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void WorkerPool::run(std::function< void() > const &job) {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		jobs.emplace_back(job);
+	}
+	work_cv.notify_one();
+}
+
+void WorkerPool::parallel_for(uint32_t count, uint32_t chunk, std::function< void(uint32_t, uint32_t) > const &fn) {
+	if (count == 0) return;
+	chunk = std::max(1U, chunk);
+	uint32_t chunks = (count + chunk - 1) / chunk;
+	if (chunks == 1) {
+		fn(0, count);
+		return;
+	}
+
+	//state is shared with helper jobs, which may get to run after this call returns:
+	struct State {
+		std::function< void(uint32_t, uint32_t) > fn;
+		uint32_t count, chunk, chunks;
+		std::atomic< uint32_t > next{0};
+		std::atomic< uint32_t > finished{0};
+		std::atomic< bool > failed{false};
+		std::exception_ptr exception; //first exception thrown by fn (guarded by mutex)
+		std::mutex mutex;
+		std::condition_variable cv;
+	};
+	auto state = std::make_shared< State >();
+	state->fn = fn;
+	state->count = count;
+	state->chunk = chunk;
+	state->chunks = chunks;
+
+	auto work = [](State &s) {
+		while (true) {
+			uint32_t c = s.next.fetch_add(1);
+			if (c >= s.chunks) break;
+			uint32_t begin = c * s.chunk;
+			//once some chunk has thrown, the rest are skipped (but still counted, so the caller's wait ends):
+			if (!s.failed.load()) {
+				try {
+					s.fn(begin, std::min(s.count, begin + s.chunk));
+				} catch (...) {
+					std::unique_lock< std::mutex > lock(s.mutex);
+					if (!s.exception) s.exception = std::current_exception();
+					s.failed = true;
+				}
+			}
+			if (s.finished.fetch_add(1) + 1 == s.chunks) {
+				std::unique_lock< std::mutex > lock(s.mutex);
+				s.cv.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = std::min(size(), chunks - 1);
+	for (uint32_t i = 0; i < helpers; ++i) {
+		run([state, work](){ work(*state); });
+	}
+	work(*state);
+
+	std::unique_lock< std::mutex > lock(state->mutex);
+	state->cv.wait(lock, [&](){ return state->finished.load() == chunks; });
+
+	//every chunk is done (so nothing is still using fn's captures); pass along any exception:
+	if (state->exception) std::rethrow_exception(state->exception);
+}
+
+void WorkerPool::wait() {
+	std::unique_lock< std::mutex > lock(mutex);
+	done_cv.wait(lock, [this](){ return running == 0 && jobs.empty(); });
+}
+
+WorkerPool &WorkerPool::shared() {
+	static WorkerPool pool;
+	return pool;
+}
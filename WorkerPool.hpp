@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * WorkerPool runs jobs on a set of background threads.
+ *
+ * Jobs must not make OpenGL calls -- the context belongs to the main thread.
+ */
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+struct WorkerPool {
+	//start 'threads' workers (0 => one per hardware thread, less one for the main thread):
+	WorkerPool(uint32_t threads = 0);
+	~WorkerPool(); //finishes any queued jobs, then joins workers
+
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	//queue a job to run on some worker:
+	void run(std::function< void() > const &job);
+
+	//call fn(begin, end) over [0,count) in chunks of (at most) 'chunk' items; returns once all chunks are done.
+	// the calling thread works on chunks as well, so this is safe to call from inside a job.
+	// if fn throws, remaining chunks are skipped and the first exception is rethrown (after all running chunks finish):
+	void parallel_for(uint32_t count, uint32_t chunk, std::function< void(uint32_t, uint32_t) > const &fn);
+
+	//wait until all queued jobs have completed:
+	void wait();
+
+	uint32_t size() const { return uint32_t(workers.size()); }
+
+	//pool shared by engine subsystems (created on first use):
+	static WorkerPool &shared();
+
+	//internals:
+	std::vector< std::thread > workers;
+	std::mutex mutex;
+	std::condition_variable work_cv; //signalled when a job is queued or pool is quitting
+	std::condition_variable done_cv; //signalled when the pool runs out of work
+	std::deque< std::function< void() > > jobs;
+	uint32_t running = 0; //jobs currently being run by workers
+	bool quit = false;
+};
@@ -14,7 +14,16 @@
 #include "GL.hpp"
 
 //for screenshots:
-#include "load_save_png.hpp"
+#include "ScreenshotCapture.hpp"
+
+//for streaming texture uploads:
+#include "TextureLoader.hpp"
+
+//for headless benchmarking:
+#include "FrameBenchmark.hpp"
+
+//for running update() alongside draw() when pipelined:
+#include "WorkerPool.hpp"
 
 //Includes for libSDL:
 #include <SDL.h>
@@ -25,6 +34,7 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <future>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -45,6 +55,23 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//'--benchmark' and friends (see FrameBenchmark.hpp) are picked out first:
+	FrameBenchmark benchmark;
+	benchmark.parse_arguments(argc, argv);
+
+	//'--pipelined' runs each frame's update on a worker thread while the previous frame is drawn:
+	bool pipelined = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--pipelined") {
+			pipelined = true;
+		} else {
+			std::cerr << "NOTE: ignoring unrecognized argument '" << arg << "'." << std::endl;
+		}
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -72,6 +99,7 @@ int main(int argc, char **argv) {
 		SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		| (benchmark.enabled() ? SDL_WINDOW_HIDDEN : 0) //benchmarks draw offscreen
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -95,7 +123,10 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
+	if (benchmark.enabled()) {
+		//...unless benchmarking, when frames shouldn't wait on the display:
+		SDL_GL_SetSwapInterval(0);
+	} else if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (SDL_GL_SetSwapInterval(1) != 0) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -114,6 +145,9 @@ int main(int argc, char **argv) {
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< PlayMode >());
 
+	//'--depth-prepass' and '--overdraw' (see FrameBenchmark.hpp) apply to interactive runs too:
+	benchmark.configure(*Mode::current);
+
 	//------------ main loop ------------
 
 	//this inline function will be called whenever the window is resized,
@@ -131,8 +165,26 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//screenshots are read back asynchronously and encoded on a worker thread:
+	ScreenshotCapture screenshots;
+	bool screenshot_requested = false;
+
+	//in pipelined mode, the update that is running on a worker thread:
+	std::future< void > pending_update;
+
+	//'--benchmark' draws a fixed number of frames offscreen, reports timings, and quits:
+	bool benchmark_ok = true;
+	if (benchmark.enabled()) {
+		benchmark_ok = benchmark.run();
+		Mode::set_current(nullptr);
+	}
+
 	//This will loop until the current mode is set to null:
-	while (Mode::current) {
+	while (true) {
+		//in pipelined mode, the previous update must finish before mode state is touched again:
+		if (pending_update.valid()) pending_update.get();
+		if (!Mode::current) break;
+
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
@@ -151,23 +203,21 @@ int main(int argc, char **argv) {
 					break;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
-					std::string filename = "screenshot.png";
-					std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
-					glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-					glReadBuffer(GL_FRONT);
-					int w,h;
-					SDL_GL_GetDrawableSize(window, &w, &h);
-					std::vector< glm::u8vec4 > data(w*h);
-					glReadPixels(0,0,w,h, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-					for (auto &px : data) {
-						px.a = 0xff;
+					if (SDL_GetModState() & KMOD_SHIFT) {
+						//shift + printscreen toggles frame-sequence capture:
+						if (screenshots.recording()) screenshots.stop_sequence();
+						else screenshots.start_sequence("frame");
+					} else {
+						screenshot_requested = true;
 					}
-					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
 				}
 			}
 			if (!Mode::current) break;
 		}
 
+		//mode being updated/drawn this frame (update may change Mode::current):
+		std::shared_ptr< Mode > mode;
+
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
@@ -178,21 +228,52 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
-			Mode::current->update(elapsed);
-			if (!Mode::current) break;
+			mode = Mode::current;
+			if (pipelined && mode->can_pipeline()) {
+				//draw this frame from the state as of the last update, while the next update runs:
+				mode->snapshot();
+				auto done = std::make_shared< std::promise< void > >();
+				pending_update = done->get_future();
+				WorkerPool::shared().run([mode, elapsed, done](){
+					try {
+						mode->update(elapsed);
+						done->set_value();
+					} catch (...) {
+						done->set_exception(std::current_exception());
+					}
+				});
+			} else {
+				mode->update(elapsed);
+				if (!Mode::current) break;
+				mode = Mode::current;
+				mode->snapshot();
+			}
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
-			Mode::current->draw(drawable_size);
+			//spend a bit of each frame uploading any textures that have finished decoding:
+			TextureLoader::shared().update();
+
+			mode->draw(drawable_size);
 		}
 
+		//capture the back buffer before it is swapped away (pixels are saved a frame or two later):
+		if (screenshot_requested) {
+			std::string filename = "screenshot.png";
+			std::cout << "Saving screenshot to '" << filename << "'." << std::endl;
+			screenshots.capture(drawable_size, filename);
+			screenshot_requested = false;
+		}
+		screenshots.poll(drawable_size);
+
 		//Wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(window);
 	}
 
 
 	//------------  teardown ------------
+	screenshots.finish();
+
 	Sound::shutdown();
 
 	SDL_GL_DeleteContext(context);
@@ -201,7 +282,7 @@ int main(int argc, char **argv) {
 	SDL_DestroyWindow(window);
 	window = NULL;
 
-	return 0;
+	return benchmark_ok ? 0 : 1;
 
 #ifdef _WIN32
 	} catch (std::exception const &e) {
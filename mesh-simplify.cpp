@@ -0,0 +1,399 @@
+//mesh-simplify adds levels of detail to a .pnct mesh file:
+// each mesh is simplified by quadric-error-metric edge collapses (Garland & Heckbert, "Surface Simplification
+// Using Quadric Error Metrics", 1997), and snapshots at successive triangle budgets are appended to the
+// vertex data and listed in a 'lod0' chunk that MeshBuffer reads into Mesh::lods.
+
+#include "read_write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <vector>
+
+//same layout as MeshBuffer's 'pnct' vertices:
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+struct IndexEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+struct LodEntry {
+	uint32_t mesh;
+	uint32_t vertex_begin, vertex_end;
+	float max_size;
+};
+static_assert(sizeof(LodEntry) == 16, "Lod entry should be packed");
+
+//symmetric 4x4 matrix, stored as its upper triangle:
+struct Quadric {
+	double a[10] = {0,0,0,0,0,0,0,0,0,0};
+
+	//quadric measuring squared distance to plane dot(n, p) + d = 0 (with |n| = 1):
+	static Quadric plane(glm::dvec3 const &n, double d, double weight = 1.0) {
+		Quadric q;
+		double p[4] = { n.x, n.y, n.z, d };
+		uint32_t k = 0;
+		for (uint32_t r = 0; r < 4; ++r) {
+			for (uint32_t c = r; c < 4; ++c) {
+				q.a[k++] = weight * p[r] * p[c];
+			}
+		}
+		return q;
+	}
+	Quadric &operator+=(Quadric const &o) {
+		for (uint32_t k = 0; k < 10; ++k) a[k] += o.a[k];
+		return *this;
+	}
+	double error(glm::dvec3 const &p) const {
+		//v^T Q v with v = (p, 1):
+		return a[0]*p.x*p.x + 2.0*a[1]*p.x*p.y + 2.0*a[2]*p.x*p.z + 2.0*a[3]*p.x
+		     + a[4]*p.y*p.y + 2.0*a[5]*p.y*p.z + 2.0*a[6]*p.y
+		     + a[7]*p.z*p.z + 2.0*a[8]*p.z
+		     + a[9];
+	}
+	//position minimizing the error, if well-defined:
+	bool minimizer(glm::dvec3 *p) const {
+		//solve [a0 a1 a2; a1 a4 a5; a2 a5 a7] p = -(a3, a6, a8) by Cramer's rule:
+		glm::dvec3 c0(a[0], a[1], a[2]), c1(a[1], a[4], a[5]), c2(a[2], a[5], a[7]);
+		glm::dvec3 b(-a[3], -a[6], -a[8]);
+		double det = glm::dot(c0, glm::cross(c1, c2));
+		//(relative threshold, so nearly-flat neighborhoods fall back to picking among the endpoints)
+		double scale = a[0] + a[4] + a[7];
+		if (!(std::abs(det) > 1e-9 * scale * scale * scale)) return false;
+		*p = glm::dvec3(
+			glm::dot(b, glm::cross(c1, c2)),
+			glm::dot(c0, glm::cross(b, c2)),
+			glm::dot(c0, glm::cross(c1, b))
+		) / det;
+		return true;
+	}
+};
+
+//a simplification level: triangles (as corner vertices) and the worst collapse error so far:
+struct Level {
+	std::vector< Vertex > vertices;
+	float error = 0.0f;
+};
+
+//simplify the triangle soup 'corners', snapshotting whenever the triangle count falls below each of 'budgets' (decreasing):
+static std::vector< Level > simplify(std::vector< Vertex > const &corners, std::vector< uint32_t > const &budgets) {
+	std::vector< Level > levels;
+	uint32_t triangle_count = uint32_t(corners.size() / 3);
+	if (triangle_count == 0 || budgets.empty()) return levels;
+
+	//weld corners into vertices by position:
+	std::vector< glm::dvec3 > position;
+	std::vector< uint32_t > corner_vertex(corners.size());
+	{
+		std::map< std::tuple< float, float, float >, uint32_t > welded;
+		for (uint32_t c = 0; c < corners.size(); ++c) {
+			glm::vec3 const &p = corners[c].Position;
+			auto ret = welded.emplace(std::make_tuple(p.x, p.y, p.z), uint32_t(position.size()));
+			if (ret.second) position.emplace_back(p);
+			corner_vertex[c] = ret.first->second;
+		}
+	}
+	uint32_t vertex_count = uint32_t(position.size());
+
+	struct Triangle {
+		uint32_t v[3]; //(welded) vertices
+		bool dead = false;
+	};
+	std::vector< Triangle > triangles(triangle_count);
+	std::vector< std::vector< uint32_t > > vertex_triangles(vertex_count);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		for (uint32_t k = 0; k < 3; ++k) {
+			triangles[t].v[k] = corner_vertex[3*t+k];
+			vertex_triangles[triangles[t].v[k]].emplace_back(t);
+		}
+		if (triangles[t].v[0] == triangles[t].v[1] || triangles[t].v[1] == triangles[t].v[2] || triangles[t].v[2] == triangles[t].v[0]) {
+			triangles[t].dead = true; //already degenerate
+		}
+	}
+
+	auto face_normal = [&](Triangle const &tri, uint32_t moved, glm::dvec3 const &to) {
+		glm::dvec3 p[3];
+		for (uint32_t k = 0; k < 3; ++k) p[k] = (tri.v[k] == moved ? to : position[tri.v[k]]);
+		return glm::cross(p[1] - p[0], p[2] - p[0]);
+	};
+
+	//quadrics from face planes, plus perpendicular planes along open edges so that borders stay put:
+	std::vector< Quadric > quadric(vertex_count);
+	std::map< std::pair< uint32_t, uint32_t >, uint32_t > edge_uses;
+	for (auto const &tri : triangles) {
+		if (tri.dead) continue;
+		for (uint32_t k = 0; k < 3; ++k) {
+			edge_uses[std::minmax(tri.v[k], tri.v[(k+1)%3])] += 1;
+		}
+	}
+	for (auto const &tri : triangles) {
+		if (tri.dead) continue;
+		glm::dvec3 n = face_normal(tri, -1U, glm::dvec3(0.0));
+		double len = glm::length(n);
+		if (len == 0.0) continue;
+		n /= len;
+		Quadric q = Quadric::plane(n, -glm::dot(n, position[tri.v[0]]));
+		for (uint32_t k = 0; k < 3; ++k) {
+			quadric[tri.v[k]] += q;
+
+			uint32_t a = tri.v[k], b = tri.v[(k+1)%3];
+			if (edge_uses[std::minmax(a, b)] != 1) continue;
+			glm::dvec3 along = position[b] - position[a];
+			glm::dvec3 out = glm::cross(along, n);
+			double out_len = glm::length(out);
+			if (out_len == 0.0) continue;
+			out /= out_len;
+			Quadric border = Quadric::plane(out, -glm::dot(out, position[a]), 10.0);
+			quadric[a] += border;
+			quadric[b] += border;
+		}
+	}
+
+	//candidate collapses, cheapest first; entries go stale when either endpoint changes:
+	std::vector< uint32_t > version(vertex_count, 0);
+	std::vector< bool > removed(vertex_count, false);
+	struct Candidate {
+		double cost;
+		uint32_t a, b;
+		uint32_t version_a, version_b;
+		glm::dvec3 target;
+		bool operator<(Candidate const &o) const { return cost > o.cost; } //(so priority_queue pops cheapest)
+	};
+	std::priority_queue< Candidate > candidates;
+
+	auto consider = [&](uint32_t a, uint32_t b) {
+		Quadric q = quadric[a];
+		q += quadric[b];
+		glm::dvec3 target;
+		if (!q.minimizer(&target)) {
+			target = 0.5 * (position[a] + position[b]);
+		}
+		double cost = q.error(target);
+		for (glm::dvec3 const &p : { position[a], position[b] }) {
+			double e = q.error(p);
+			if (e < cost) {
+				cost = e;
+				target = p;
+			}
+		}
+		candidates.push(Candidate{ std::max(0.0, cost), a, b, version[a], version[b], target });
+	};
+	auto consider_around = [&](uint32_t v) {
+		for (uint32_t t : vertex_triangles[v]) {
+			if (triangles[t].dead) continue;
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t w = triangles[t].v[k];
+				if (w != v) consider(std::min(v, w), std::max(v, w));
+			}
+		}
+	};
+	for (auto const &tri : triangles) {
+		if (tri.dead) continue;
+		for (uint32_t k = 0; k < 3; ++k) {
+			//(interior edges show up twice, once each way; border edges just once)
+			uint32_t a = tri.v[k], b = tri.v[(k+1)%3];
+			if (a < b || edge_uses[std::minmax(a, b)] == 1) consider(std::min(a, b), std::max(a, b));
+		}
+	}
+
+	uint32_t live = 0;
+	for (auto const &tri : triangles) live += (tri.dead ? 0 : 1);
+
+	double max_error = 0.0;
+	auto snapshot = [&]() {
+		Level level;
+		level.error = float(std::sqrt(max_error));
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			if (triangles[t].dead) continue;
+			for (uint32_t k = 0; k < 3; ++k) {
+				//corners keep their own normal, color, and texcoord:
+				Vertex vertex = corners[3*t+k];
+				vertex.Position = glm::vec3(position[triangles[t].v[k]]);
+				level.vertices.emplace_back(vertex);
+			}
+		}
+		levels.emplace_back(std::move(level));
+	};
+
+	uint32_t next_budget = 0;
+	while (next_budget < budgets.size() && !candidates.empty()) {
+		if (live <= budgets[next_budget]) {
+			snapshot();
+			next_budget += 1;
+			continue;
+		}
+
+		Candidate c = candidates.top();
+		candidates.pop();
+		if (removed[c.a] || removed[c.b] || version[c.a] != c.version_a || version[c.b] != c.version_b) continue;
+
+		//reject collapses that would flip (or squash) any remaining triangle:
+		bool ok = true;
+		for (uint32_t v : { c.a, c.b }) {
+			for (uint32_t t : vertex_triangles[v]) {
+				Triangle const &tri = triangles[t];
+				if (tri.dead) continue;
+				bool has_a = (tri.v[0] == c.a || tri.v[1] == c.a || tri.v[2] == c.a);
+				bool has_b = (tri.v[0] == c.b || tri.v[1] == c.b || tri.v[2] == c.b);
+				if (has_a && has_b) continue; //will collapse away
+				glm::dvec3 before = face_normal(tri, -1U, glm::dvec3(0.0));
+				glm::dvec3 after = face_normal(tri, v, c.target);
+				double before_len = glm::length(before), after_len = glm::length(after);
+				if (after_len <= 1e-12 * before_len || glm::dot(before, after) < 0.2 * before_len * after_len) {
+					ok = false;
+					break;
+				}
+			}
+			if (!ok) break;
+		}
+		if (!ok) continue;
+
+		//collapse b into a:
+		max_error = std::max(max_error, c.cost);
+		position[c.a] = c.target;
+		quadric[c.a] += quadric[c.b];
+		removed[c.b] = true;
+		version[c.a] += 1;
+		for (uint32_t t : vertex_triangles[c.b]) {
+			Triangle &tri = triangles[t];
+			if (tri.dead) continue;
+			bool has_a = (tri.v[0] == c.a || tri.v[1] == c.a || tri.v[2] == c.a);
+			if (has_a) {
+				tri.dead = true;
+				live -= 1;
+			} else {
+				for (uint32_t k = 0; k < 3; ++k) {
+					if (tri.v[k] == c.b) tri.v[k] = c.a;
+				}
+				vertex_triangles[c.a].emplace_back(t);
+			}
+		}
+		std::vector< uint32_t >().swap(vertex_triangles[c.b]);
+		//(drop dead triangles from a's list as we go, so it doesn't grow without bound)
+		auto &around = vertex_triangles[c.a];
+		around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t){ return triangles[t].dead; }), around.end());
+
+		consider_around(c.a);
+	}
+	//(budgets that couldn't be reached get the most-simplified result, if it improved on the last snapshot)
+	if (next_budget < budgets.size() && (levels.empty() || live * 3 < levels.back().vertices.size())) {
+		snapshot();
+	}
+
+	return levels;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2 || argc > 6) {
+		std::cerr << "Usage:\n\t./mesh-simplify <in.pnct> [out.pnct] [levels=3] [ratio=0.5] [pixels=1.0]\n"
+		             "Appends 'levels' levels of detail to each mesh, each with 'ratio' times the triangles of the last;\n"
+		             "levels are picked at runtime so the simplification error stays under about 'pixels' pixels (at 1080p).\n"
+		             "(writes back to in.pnct if out.pnct is not given)" << std::endl;
+		return 1;
+	}
+	std::string in_filename = argv[1];
+	std::string out_filename = (argc >= 3 ? argv[2] : argv[1]);
+	uint32_t level_count = (argc >= 4 ? uint32_t(std::stoul(argv[3])) : 3);
+	float ratio = (argc >= 5 ? std::stof(argv[4]) : 0.5f);
+	float pixels = (argc >= 6 ? std::stof(argv[5]) : 1.0f);
+	if (!(ratio > 0.0f && ratio < 1.0f) || !(pixels > 0.0f)) {
+		std::cerr << "Expecting 0 < ratio < 1 and pixels > 0." << std::endl;
+		return 1;
+	}
+
+	std::vector< Vertex > vertices;
+	std::vector< char > strings;
+	std::vector< IndexEntry > index;
+	try {
+		std::ifstream file(in_filename, std::ios::binary);
+		read_chunk(file, "pnct", &vertices);
+		read_chunk(file, "str0", &strings);
+		read_chunk(file, "idx0", &index);
+		if (peek_chunk(file, "lod0")) {
+			//already simplified; drop the old levels (which were appended after all the meshes):
+			std::vector< LodEntry > old;
+			read_chunk(file, "lod0", &old);
+			uint32_t end = 0;
+			for (auto const &entry : index) end = std::max(end, entry.vertex_end);
+			vertices.resize(std::min(size_t(end), vertices.size()));
+		}
+	} catch (std::exception &e) {
+		std::cerr << "Failed to read '" << in_filename << "': " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::vector< LodEntry > lods;
+	for (uint32_t i = 0; i < index.size(); ++i) {
+		IndexEntry const &entry = index[i];
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size()
+		   && entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= vertices.size())) {
+			std::cerr << "Index entry " << i << " of '" << in_filename << "' is out of range." << std::endl;
+			return 1;
+		}
+		std::string name(strings.begin() + entry.name_begin, strings.begin() + entry.name_end);
+
+		std::vector< Vertex > corners(vertices.begin() + entry.vertex_begin, vertices.begin() + entry.vertex_end);
+		if (corners.size() % 3 != 0) {
+			std::cerr << "Skipping '" << name << "': not a triangle list." << std::endl;
+			continue;
+		}
+
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		for (auto const &v : corners) {
+			min = glm::min(min, v.Position);
+			max = glm::max(max, v.Position);
+		}
+		float radius = 0.5f * glm::length(max - min);
+
+		std::vector< uint32_t > budgets;
+		float budget = float(corners.size() / 3);
+		for (uint32_t l = 0; l < level_count; ++l) {
+			budget *= ratio;
+			if (budget < 4.0f) break;
+			budgets.emplace_back(uint32_t(budget));
+		}
+
+		std::cout << "'" << name << "': " << corners.size() / 3 << " triangles";
+		for (Level const &level : simplify(corners, budgets)) {
+			LodEntry lod;
+			lod.mesh = i;
+			lod.vertex_begin = uint32_t(vertices.size());
+			vertices.insert(vertices.end(), level.vertices.begin(), level.vertices.end());
+			lod.vertex_end = uint32_t(vertices.size());
+			//projected error (in pixels at 1080p) is error * size / radius * 540, where size is projected radius / viewport half-height:
+			lod.max_size = (level.error > 0.0f ? radius * pixels / (540.0f * level.error) : std::numeric_limits< float >::max());
+			lods.emplace_back(lod);
+			std::cout << " -> " << level.vertices.size() / 3 << " (error " << level.error << ")";
+		}
+		std::cout << std::endl;
+	}
+
+	std::ofstream out(out_filename, std::ios::binary);
+	write_chunk("pnct", vertices, &out);
+	write_chunk("str0", strings, &out);
+	write_chunk("idx0", index, &out);
+	write_chunk("lod0", lods, &out);
+	if (!out) {
+		std::cerr << "Failed to write '" << out_filename << "'." << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << lods.size() << " levels of detail for " << index.size() << " meshes to '" << out_filename << "'." << std::endl;
+	return 0;
+}
@@ -40,6 +40,17 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	}
 }
 
+//helper function that checks (without consuming anything) whether the next chunk has the given magic number:
+// (useful for optional chunks)
+inline bool peek_chunk(std::istream &from, std::string const &magic) {
+	assert(magic.size() == 4);
+	char header[4];
+	std::streampos at = from.tellg();
+	bool match = from.read(header, 4) && std::string(header, 4) == magic;
+	from.clear();
+	from.seekg(at);
+	return match;
+}
 
 //helper function to write a chunk of data in the same format as read_chunk:
 template< typename T >
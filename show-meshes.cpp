@@ -3,6 +3,7 @@
 #include "Load.hpp"
 #include "GL.hpp"
 #include "load_save_png.hpp"
+#include "FrameBenchmark.hpp"
 
 #include <SDL.h>
 
@@ -18,6 +19,12 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//'--benchmark' and friends (see FrameBenchmark.hpp) are picked out first, leaving the viewer's own arguments:
+	FrameBenchmark benchmark;
+	benchmark.parse_arguments(argc, argv);
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -45,6 +52,7 @@ int main(int argc, char **argv) {
 		SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		| (benchmark.enabled() ? SDL_WINDOW_HIDDEN : 0) //benchmarks draw offscreen
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -68,7 +76,10 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
+	if (benchmark.enabled()) {
+		//...unless benchmarking, when frames shouldn't wait on the display:
+		SDL_GL_SetSwapInterval(0);
+	} else if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (SDL_GL_SetSwapInterval(1) != 0) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -92,12 +103,13 @@ int main(int argc, char **argv) {
 	}
 	if (buffer) {
 		Mode::set_current(std::make_shared< ShowMeshesMode >(*buffer));
+		benchmark.configure(*Mode::current); //('--depth-prepass', '--overdraw')
 	}
 	if (!Mode::current) {
 		usage = true;
 	}
 	if (usage) {
-		std::cerr << "Usage:\n\t" << argv[0] << " [path/to/meshes.pnct]" << std::endl;
+		std::cerr << "Usage:\n\t" << argv[0] << " [path/to/meshes.pnct] [--benchmark <frames> ...] [--depth-prepass] [--overdraw]" << std::endl;
 		return 1;
 	}
 
@@ -118,6 +130,13 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//'--benchmark' draws a fixed number of frames offscreen, reports timings, and quits:
+	bool benchmark_ok = true;
+	if (benchmark.enabled()) {
+		benchmark_ok = benchmark.run();
+		Mode::set_current(nullptr);
+	}
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
@@ -186,7 +205,7 @@ int main(int argc, char **argv) {
 	SDL_DestroyWindow(window);
 	window = NULL;
 
-	return 0;
+	return benchmark_ok ? 0 : 1;
 
 #ifdef _WIN32
 	} catch (std::exception const &e) {
@@ -4,6 +4,7 @@
 #include "GL.hpp"
 #include "load_save_png.hpp"
 #include "ShowSceneProgram.hpp"
+#include "FrameBenchmark.hpp"
 
 #include <SDL.h>
 
@@ -12,6 +13,7 @@
 #include <stdexcept>
 #include <memory>
 #include <algorithm>
+#include <thread>
 
 int main(int argc, char **argv) {
 #ifdef _WIN32
@@ -19,6 +21,12 @@ int main(int argc, char **argv) {
 	try {
 #endif
 
+	//------------  command line ------------
+
+	//'--benchmark' and friends (see FrameBenchmark.hpp) are picked out first, leaving the viewer's own arguments:
+	FrameBenchmark benchmark;
+	benchmark.parse_arguments(argc, argv);
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -46,6 +54,7 @@ int main(int argc, char **argv) {
 		SDL_WINDOW_OPENGL
 		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
 		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		| (benchmark.enabled() ? SDL_WINDOW_HIDDEN : 0) //benchmarks draw offscreen
 	);
 
 	//prevent exceedingly tiny windows when resizing:
@@ -69,7 +78,10 @@ int main(int argc, char **argv) {
 	init_GL();
 
 	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
+	if (benchmark.enabled()) {
+		//...unless benchmarking, when frames shouldn't wait on the display:
+		SDL_GL_SetSwapInterval(0);
+	} else if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
 		if (SDL_GL_SetSwapInterval(1) != 0) {
 			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
@@ -103,36 +115,56 @@ int main(int argc, char **argv) {
 			buffer = nullptr;
 		}
 	}
+	//the scene is parsed in the background and merged a few entries per frame (see SceneStreamer), so the viewer starts right away:
 	Scene *scene = nullptr;
+	SceneStreamer *streamer = nullptr;
 	if (scene_file != "") {
-		try {
-			scene = new Scene();
-			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-				if (!buffer_vao) return;
-				Mesh const &mesh = buffer->lookup(mesh_name);
+		scene = new Scene();
+		streamer = new SceneStreamer(*scene, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+			if (!buffer_vao) return;
+			Mesh const *mesh = nullptr;
+			try {
+				mesh = &buffer->lookup(mesh_name);
+			} catch (std::exception &e) {
+				std::cerr << "WARNING: not showing '" << transform->name << "': " << e.what() << std::endl;
+				return;
+			}
 
-				scene.drawables.emplace_back(transform);
-				Scene::Drawable &drawable = scene.drawables.back();
+			scene.drawables.emplace_back(transform);
+			Scene::Drawable &drawable = scene.drawables.back();
 
-				drawable.pipeline = show_scene_program_pipeline;
+			drawable.pipeline = show_scene_program_pipeline;
 
-				drawable.pipeline.vao = buffer_vao;
-				drawable.pipeline.type = mesh.type;
-				drawable.pipeline.start = mesh.start;
-				drawable.pipeline.count = mesh.count;
+			drawable.pipeline.vao = buffer_vao;
+			drawable.pipeline.type = mesh->type;
+			drawable.pipeline.start = mesh->start;
+			drawable.pipeline.count = mesh->count;
+			for (Mesh::Lod const &lod : mesh->lods) {
+				drawable.pipeline.lods.emplace_back(Scene::Drawable::Pipeline::Lod{ lod.start, lod.count, lod.max_size });
+			}
 
-			});
-		} catch (std::exception &e) {
-			std::cerr << "ERROR loading scene '" << scene_file << "': " << e.what() << std::endl;
+			drawable.min = mesh->min;
+			drawable.max = mesh->max;
+			drawable.occluder = mesh->occluder;
+
+		});
+		streamer->request(scene_file, scene_file);
+
+		//wait for the parse (but not the merge), so a bad file still gets reported here:
+		while (streamer->state(scene_file) == SceneStreamer::Parsing) {
+			streamer->update(0);
+			std::this_thread::yield();
+		}
+		if (streamer->state(scene_file) == SceneStreamer::Failed) {
+			std::cerr << "ERROR loading scene '" << scene_file << "' (see above)." << std::endl;
 			usage = true;
-			scene = nullptr;
 		}
 	}
 	if (!scene) {
 		usage = true;
 	}
 	if (usage) {
-		std::cerr << "Usage:\n\t" << argv[0] << " <path/to/scene.scene> [path/to/meshes.pnct]" << std::endl;
+		std::cerr << "Usage:\n\t" << argv[0] << " <path/to/scene.scene> [path/to/meshes.pnct] [--benchmark <frames> ...] [--depth-prepass] [--overdraw]" << std::endl;
 		return 1;
 	}
 	std::cout << "Showing scene from '" << scene_file << "' with";
@@ -141,7 +173,8 @@ int main(int argc, char **argv) {
 	} else {
 		std::cout << " no meshes -- consider passing a '.pnct' file as the second argument." << std::endl;
 	}
-	Mode::set_current(std::make_shared< ShowSceneMode >(*scene));
+	Mode::set_current(std::make_shared< ShowSceneMode >(*scene, streamer));
+	benchmark.configure(*Mode::current); //('--depth-prepass', '--overdraw')
 
 	//------------ main loop ------------
 
@@ -160,6 +193,18 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//'--benchmark' draws a fixed number of frames offscreen, reports timings, and quits:
+	bool benchmark_ok = true;
+	if (benchmark.enabled()) {
+		//time the whole scene, not the frames where it is still streaming in:
+		while (streamer->state(scene_file) == SceneStreamer::Merging) {
+			streamer->update(-1U);
+			std::this_thread::yield();
+		}
+		benchmark_ok = benchmark.run();
+		Mode::set_current(nullptr);
+	}
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
@@ -228,7 +273,7 @@ int main(int argc, char **argv) {
 	SDL_DestroyWindow(window);
 	window = NULL;
 
-	return 0;
+	return benchmark_ok ? 0 : 1;
 
 #ifdef _WIN32
 	} catch (std::exception const &e) {
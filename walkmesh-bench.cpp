@@ -0,0 +1,176 @@
+//walkmesh-bench measures WalkMesh walking throughput:
+// - projections/sec: per-call cross-product barycentrics (the old approach) vs. precomputed barycentric_planes
+// - steps/sec: PlayMode-style walking with and without the WalkPoint::triangle hint
+// - paths/sec: WalkMeshNav queries, one at a time and as an async batch
+// - rays/sec: walkmesh.bvh raycasts, one at a time and batched
+
+#include "WalkMesh.hpp"
+#include "WalkMeshNav.hpp"
+
+#include <glm/gtx/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+//reference implementation: barycentric weights computed from scratch (four cross products per call):
+static glm::vec3 barycentric_from_scratch(glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c, glm::vec3 const &pt) {
+	glm::vec3 norm = glm::cross(b-a, c-a);
+	glm::vec3 ab_perp = glm::cross(norm, b-a);
+	glm::vec3 bc_perp = glm::cross(norm, c-b);
+	glm::vec3 ca_perp = glm::cross(norm, a-c);
+
+	float abp_area = glm::dot(ab_perp, pt-a);
+	float bcp_area = glm::dot(bc_perp, pt-b);
+	float cap_area = glm::dot(ca_perp, pt-c);
+	float total = abp_area + bcp_area + cap_area;
+	return glm::vec3(bcp_area / total, cap_area / total, abp_area / total);
+}
+
+//take one walking step of (world-space) length 'step' from 'at', as PlayMode::update does:
+static void walk(WalkMesh const &walkmesh, WalkPoint &at, glm::vec3 remain, bool use_hint) {
+	for (uint32_t iter = 0; iter < 10; ++iter) {
+		if (remain == glm::vec3(0.0f)) break;
+		if (!use_hint) at.triangle = -1U;
+		WalkPoint end;
+		float time;
+		walkmesh.walk_in_triangle(at, remain, &end, &time);
+		at = end;
+		if (time == 1.0f) break;
+		remain *= (1.0f - time);
+		glm::quat rotation;
+		if (!use_hint) at.triangle = -1U;
+		if (walkmesh.cross_edge(at, &end, &rotation)) {
+			at = end;
+			remain = rotation * remain;
+		} else {
+			break;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2 || argc > 4) {
+		std::cerr << "Usage:\n\t./walkmesh-bench <file.w> [mesh-name] [steps]" << std::endl;
+		return 1;
+	}
+	std::string filename = argv[1];
+	std::string name = (argc >= 3 ? argv[2] : "WalkMesh");
+	uint32_t steps = (argc >= 4 ? uint32_t(std::stoul(argv[3])) : 1000000);
+
+	WalkMeshes walkmeshes(filename);
+	WalkMesh const &walkmesh = walkmeshes.lookup(name);
+	std::cout << "'" << name << "': " << walkmesh.vertices.size() << " vertices, " << walkmesh.triangles.size() << " triangles." << std::endl;
+
+	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+	for (auto const &v : walkmesh.vertices) {
+		min = glm::min(min, v);
+		max = glm::max(max, v);
+	}
+
+	std::mt19937 mt(0x31415926);
+	auto random_point = [&]() {
+		std::uniform_real_distribution< float > u(0.0f, 1.0f);
+		return glm::mix(min, max, glm::vec3(u(mt), u(mt), u(mt)));
+	};
+	auto random_step = [&]() {
+		std::uniform_real_distribution< float > u(-1.0f, 1.0f);
+		return 0.05f * glm::vec3(u(mt), u(mt), 0.0f);
+	};
+
+	auto seconds_since = [](std::chrono::high_resolution_clock::time_point before) {
+		return std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count();
+	};
+
+	{ //projection throughput:
+		std::vector< glm::vec3 > points(4096);
+		for (auto &p : points) p = random_point();
+		uint32_t triangle_count = uint32_t(walkmesh.triangles.size());
+
+		glm::vec3 sum_scratch(0.0f), sum_planes(0.0f); //accumulated so the work isn't optimized away
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < steps; ++i) {
+			glm::uvec3 const &tri = walkmesh.triangles[i % triangle_count];
+			sum_scratch += barycentric_from_scratch(walkmesh.vertices[tri.x], walkmesh.vertices[tri.y], walkmesh.vertices[tri.z], points[i % points.size()]);
+		}
+		double scratch = seconds_since(before);
+
+		before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < steps; ++i) {
+			uint32_t t = i % triangle_count;
+			sum_planes += walkmesh.barycentric_weights(WalkPoint(walkmesh.triangles[t], glm::vec3(0.0f), t), t, points[i % points.size()]);
+		}
+		double planes = seconds_since(before);
+
+		std::cout << "projections/sec: " << steps / scratch << " from scratch, " << steps / planes << " with barycentric_planes"
+		          << " (sums differ by " << glm::length(sum_scratch - sum_planes) << ")" << std::endl;
+	}
+
+	for (bool use_hint : { false, true }) { //walking throughput:
+		std::mt19937 reset(0x27182818);
+		mt = reset;
+		WalkPoint at = walkmesh.nearest_walk_point(random_point());
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < steps; ++i) {
+			walk(walkmesh, at, random_step(), use_hint);
+		}
+		double elapsed = seconds_since(before);
+		glm::vec3 final = walkmesh.to_world_point(at);
+		std::cout << "steps/sec " << (use_hint ? "with" : "without") << " triangle hint: " << steps / elapsed
+		          << " (ended at " << final.x << ", " << final.y << ", " << final.z << ")" << std::endl;
+	}
+
+	{ //pathfinding throughput:
+		WalkMeshNav nav(walkmesh);
+		std::vector< WalkMeshNav::Query > queries(std::max(1U, steps / 100));
+		std::uniform_int_distribution< uint32_t > pick(0, uint32_t(walkmesh.triangles.size()) - 1);
+		for (auto &query : queries) {
+			uint32_t a = pick(mt), b = pick(mt);
+			query.start = WalkPoint(walkmesh.triangles[a], glm::vec3(1.0f / 3.0f), a);
+			query.goal = WalkPoint(walkmesh.triangles[b], glm::vec3(1.0f / 3.0f), b);
+		}
+
+		uint32_t found = 0;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (auto const &query : queries) {
+			if (nav.find_path(query.start, query.goal).found) found += 1;
+		}
+		double single = seconds_since(before);
+
+		nav.clear_cache();
+		before = std::chrono::high_resolution_clock::now();
+		std::vector< WalkMeshNav::Path > paths = nav.find_paths_async(queries).get();
+		double batch = seconds_since(before);
+
+		std::cout << "paths/sec: " << queries.size() / single << " one at a time, " << queries.size() / batch << " as an async batch"
+		          << " (" << found << " of " << paths.size() << " found; cache " << nav.cache_hits << " hits, " << nav.cache_misses << " misses)" << std::endl;
+	}
+
+	{ //raycast throughput (rays from above the walkmesh toward random points in its bounding box):
+		std::vector< TriangleBVH::Ray > rays(steps);
+		for (auto &ray : rays) {
+			ray.origin = random_point() + glm::vec3(0.0f, 0.0f, 1.0f + (max.z - min.z));
+			ray.direction = random_point() - ray.origin;
+		}
+		std::vector< TriangleBVH::Hit > hits(rays.size());
+
+		uint32_t hit_count = 0;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < rays.size(); ++i) {
+			if (walkmesh.bvh.raycast(rays[i], &hits[i])) hit_count += 1;
+		}
+		double single = seconds_since(before);
+
+		before = std::chrono::high_resolution_clock::now();
+		walkmesh.bvh.raycast(rays.data(), uint32_t(rays.size()), hits.data());
+		double batch = seconds_since(before);
+
+		std::cout << "rays/sec: " << rays.size() / single << " one at a time, " << rays.size() / batch << " batched"
+		          << " (" << hit_count << " of " << rays.size() << " hit; " << walkmesh.bvh.nodes.size() << " bvh nodes)" << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+//walkmesh-cook validates the walkmeshes in a .w file and appends precomputed tables
+// (adjacency, barycentric frames, bvh) so the game can load them without rebuilding anything.
+
+#include "WalkMesh.hpp"
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+	if (argc < 2 || argc > 3) {
+		std::cerr << "Usage:\n\t./walkmesh-cook <in.w> [out.w]\n(writes back to in.w if out.w is not given)" << std::endl;
+		return 1;
+	}
+	std::string in_filename = argv[1];
+	std::string out_filename = (argc >= 3 ? argv[2] : argv[1]);
+
+	std::vector< glm::vec3 > vertices;
+	std::vector< glm::vec3 > normals;
+	std::vector< glm::uvec3 > triangles;
+	std::vector< char > names;
+	std::vector< WalkMeshes::IndexEntry > index;
+	std::vector< glm::uvec3 > adjacency;
+	std::vector< WalkMeshes::Frame > frames;
+	std::vector< WalkMeshes::BVHIndexEntry > bvh_index;
+	std::vector< TriangleBVH::Node > bvh_nodes;
+	std::vector< TriangleBVH::Leaf > bvh_leaves;
+
+	try {
+		WalkMeshes walkmeshes(in_filename);
+
+		//write meshes in name order, so cooking is deterministic:
+		std::vector< std::string > sorted;
+		for (auto const &[name, mesh] : walkmeshes.meshes) {
+			sorted.emplace_back(name);
+		}
+		std::sort(sorted.begin(), sorted.end());
+
+		for (std::string const &name : sorted) {
+			WalkMesh const &loaded = walkmeshes.lookup(name);
+
+			//rebuild the tables from scratch (the input may have been cooked already):
+			WalkMesh mesh(loaded.vertices, loaded.normals, loaded.triangles);
+			try {
+				mesh.validate();
+			} catch (std::exception &e) {
+				std::cerr << "WalkMesh '" << name << "' is invalid: " << e.what() << std::endl;
+				return 1;
+			}
+
+			WalkMeshes::IndexEntry entry;
+			entry.name_begin = uint32_t(names.size());
+			names.insert(names.end(), name.begin(), name.end());
+			entry.name_end = uint32_t(names.size());
+
+			entry.vertex_begin = uint32_t(vertices.size());
+			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			normals.insert(normals.end(), mesh.normals.begin(), mesh.normals.end());
+			entry.vertex_end = uint32_t(vertices.size());
+
+			entry.triangle_begin = uint32_t(triangles.size());
+			for (glm::uvec3 const &tri : mesh.triangles) {
+				triangles.emplace_back(tri + glm::uvec3(entry.vertex_begin));
+			}
+			entry.triangle_end = uint32_t(triangles.size());
+			index.emplace_back(entry);
+
+			adjacency.insert(adjacency.end(), mesh.neighbors.begin(), mesh.neighbors.end());
+			for (uint32_t t = 0; t < mesh.triangles.size(); ++t) {
+				WalkMeshes::Frame frame;
+				for (uint32_t k = 0; k < 3; ++k) {
+					frame.planes[k] = mesh.barycentric_planes[k][t];
+				}
+				frames.emplace_back(frame);
+			}
+
+			WalkMeshes::BVHIndexEntry bvh_entry;
+			bvh_entry.node_begin = uint32_t(bvh_nodes.size());
+			bvh_nodes.insert(bvh_nodes.end(), mesh.bvh.nodes.begin(), mesh.bvh.nodes.end());
+			bvh_entry.node_end = uint32_t(bvh_nodes.size());
+			bvh_entry.leaf_begin = uint32_t(bvh_leaves.size());
+			bvh_leaves.insert(bvh_leaves.end(), mesh.bvh.leaves.begin(), mesh.bvh.leaves.end());
+			bvh_entry.leaf_end = uint32_t(bvh_leaves.size());
+			bvh_index.emplace_back(bvh_entry);
+
+			std::cout << "'" << name << "': " << mesh.vertices.size() << " vertices, " << mesh.triangles.size() << " triangles, "
+			          << mesh.bvh.nodes.size() << " bvh nodes." << std::endl;
+		}
+	} catch (std::exception &e) {
+		std::cerr << "Failed to load '" << in_filename << "': " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::ofstream out(out_filename, std::ios::binary);
+	write_chunk("p...", vertices, &out);
+	write_chunk("n...", normals, &out);
+	write_chunk("tri0", triangles, &out);
+	write_chunk("str0", names, &out);
+	write_chunk("idxA", index, &out);
+	write_chunk("adj0", adjacency, &out);
+	write_chunk("frm0", frames, &out);
+	write_chunk("bvhi", bvh_index, &out);
+	write_chunk("bvh0", bvh_nodes, &out);
+	write_chunk("bvh1", bvh_leaves, &out);
+	if (!out) {
+		std::cerr << "Failed to write '" << out_filename << "'." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Wrote " << index.size() << " cooked walkmesh(es) to '" << out_filename << "'." << std::endl;
+	return 0;
+}